@@ -0,0 +1,50 @@
+/*
+ * clock.h
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __mousepad_clock_h__
+#define __mousepad_clock_h__
+
+#include <time.h>
+
+/*
+ * All deadlines are kept as nanoseconds on CLOCK_MONOTONIC,
+ *  which is also the clock that the loop's timerfd runs on.
+ */
+#define NSEC_PER_MSEC 1000000LL
+#define NSEC_PER_SEC  1000000000LL
+
+/* Current time on the monotonic clock, in nanoseconds. */
+static inline long long clock_nsec()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * NSEC_PER_SEC + t.tv_nsec;
+}
+
+/* Converts nanoseconds back into a timespec. */
+static inline struct timespec clock_timespec(long long nsec)
+{
+	struct timespec t;
+	t.tv_sec  = nsec / NSEC_PER_SEC;
+	t.tv_nsec = nsec % NSEC_PER_SEC;
+	return t;
+}
+
+#endif /* __mousepad_clock_h__ */
@@ -0,0 +1,621 @@
+/*
+ * complete.c
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "complete.h"
+#include "clock.h"
+#include "config.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <X11/keysym.h>
+
+/*
+ * Word completion: the keys typed are shadowed here, and the word
+ *  being typed is looked up in a trie of known words. The trie is built
+ *  ahead of time by mousepad-words, and mapped and searched in place;
+ *  each node keeps the few most common words below it, so a lookup is a
+ *  walk down the prefix and a glance at that node, however many words
+ *  there are.
+ *
+ * Only candidates that are picked are learned: what is typed by hand,
+ *  passwords included, is never stored. Picks are counted in two small
+ *  sorted tables, of words and of pairs of words, which hold at most
+ *  COMPLETE_MAX_LEARNED entries each, the least picked giving way.
+ *  They are written to the learned file by a thread of their own, a
+ *  few seconds after a pick, so that many picks make one write.
+ *
+ * Candidates are ranked by how common they are, plus how often they
+ *  were picked, plus how often they were picked after the previous
+ *  word, times the bigram weight.
+ */
+
+struct learned_word
+{
+	char text[COMPLETE_MAX_WORD + 1];
+	unsigned count; /* Times picked. */
+	unsigned base;  /* Count in the trie, which never changes. */
+};
+
+struct learned_pair
+{
+	char first[COMPLETE_MAX_WORD + 1];
+	char word[COMPLETE_MAX_WORD + 1];
+	unsigned count;
+};
+
+/* The mapped trie, or NULL if there is none. */
+static const struct complete_trie_header *trie;
+static const struct complete_trie_node *trie_nodes;
+static const struct complete_trie_word *trie_words;
+static const char *trie_text;
+
+/*
+ * Learned counts, in order of text. Only the main thread changes them,
+ *  holding lock; the saver only reads them, holding it too.
+ */
+static struct learned_word learned[COMPLETE_MAX_LEARNED];
+static int nlearned = 0;
+static struct learned_pair pairs[COMPLETE_MAX_LEARNED];
+static int npairs = 0;
+
+static pthread_t saver;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t picked; /* On CLOCK_MONOTONIC; see complete_init(). */
+static int dirty = 0;         /* Picks not yet written; protected by lock. */
+
+static char learned_path[512]; /* Empty if there is no home to keep it in. */
+static double bigram_weight;
+
+/* The word being typed, in lower case; longer than the maximum if too long. */
+static char shadow[COMPLETE_MAX_WORD + 1];
+static int nshadow = 0;
+static char prev[COMPLETE_MAX_WORD + 1]; /* The known word before it, or "". */
+
+static char choices[COMPLETE_CHOICES][COMPLETE_MAX_WORD + 1];
+static int nchoices = 0;
+
+/* Returns the child of trie node n for c, or -1. */
+static int trie_child(int n, char c)
+{
+	const struct complete_trie_node *node = &trie_nodes[n];
+
+	if (node->child + node->nchildren > trie->nnodes)
+		return -1;
+	for (int i = 0; i < node->nchildren; i++)
+		if (trie_nodes[node->child + i].c == c)
+			return node->child + i;
+	return -1;
+}
+
+/* Returns the trie node reached by the first len bytes of text, or -1. */
+static int trie_walk(const char *text, int len)
+{
+	int n = trie ? 0 : -1;
+
+	for (int i = 0; i < len && n >= 0; i++)
+		n = trie_child(n, text[i]);
+	return n;
+}
+
+/* Returns the text of trie word w, or NULL if the file is damaged. */
+static const char *trie_word_text(int32_t w)
+{
+	if (w < 0 || w >= trie->nwords || trie_words[w].text >= trie->ntext)
+		return NULL;
+	return trie_text + trie_words[w].text;
+}
+
+/* Returns how common the trie makes a word, or 0 if it is not there. */
+static unsigned trie_count(const char *text)
+{
+	int n = trie_walk(text, strlen(text));
+
+	if (n < 0 || trie_word_text(trie_nodes[n].word) == NULL)
+		return 0;
+	return trie_words[trie_nodes[n].word].count;
+}
+
+/* Returns nonzero if a word is in the trie. */
+static int trie_has(const char *text)
+{
+	int n = trie_walk(text, strlen(text));
+	return n >= 0 && trie_nodes[n].word >= 0;
+}
+
+/* Returns the first learned word not before text. */
+static int learned_lower(const char *text)
+{
+	int lo = 0, hi = nlearned;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (strcmp(learned[mid].text, text) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* Returns the learned word for text, or NULL. */
+static const struct learned_word *learned_find(const char *text)
+{
+	int i = learned_lower(text);
+	return (i < nlearned && !strcmp(learned[i].text, text)) ? &learned[i] : NULL;
+}
+
+/* Returns the first learned pair not before first, word. */
+static int pair_lower(const char *first, const char *word)
+{
+	int lo = 0, hi = npairs;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		int c = strcmp(pairs[mid].first, first);
+		if (c < 0 || (c == 0 && strcmp(pairs[mid].word, word) < 0))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* Count count more picks of word text. Call holding lock. */
+static void learned_add(const char *text, unsigned count)
+{
+	int i = learned_lower(text);
+
+	if (i < nlearned && !strcmp(learned[i].text, text)) {
+		learned[i].count += count;
+		return;
+	}
+
+	/* Full: the least picked word gives way. */
+	if (nlearned == COMPLETE_MAX_LEARNED) {
+		int least = 0;
+		for (int j = 1; j < nlearned; j++)
+			if (learned[j].count < learned[least].count)
+				least = j;
+		memmove(&learned[least], &learned[least + 1],
+		        (--nlearned - least) * sizeof(struct learned_word));
+		if (least < i)
+			i--;
+	}
+
+	memmove(&learned[i + 1], &learned[i], (nlearned - i) * sizeof(struct learned_word));
+	strcpy(learned[i].text, text);
+	learned[i].count = count;
+	learned[i].base = trie_count(text);
+	nlearned++;
+}
+
+/* Count count more picks of word after first. Call holding lock. */
+static void pair_add(const char *first, const char *word, unsigned count)
+{
+	int i = pair_lower(first, word);
+
+	if (i < npairs && !strcmp(pairs[i].first, first) &&
+	    !strcmp(pairs[i].word, word)) {
+		pairs[i].count += count;
+		return;
+	}
+
+	if (npairs == COMPLETE_MAX_LEARNED) {
+		int least = 0;
+		for (int j = 1; j < npairs; j++)
+			if (pairs[j].count < pairs[least].count)
+				least = j;
+		memmove(&pairs[least], &pairs[least + 1],
+		        (--npairs - least) * sizeof(struct learned_pair));
+		if (least < i)
+			i--;
+	}
+
+	memmove(&pairs[i + 1], &pairs[i], (npairs - i) * sizeof(struct learned_pair));
+	strcpy(pairs[i].first, first);
+	strcpy(pairs[i].word, word);
+	pairs[i].count = count;
+	npairs++;
+}
+
+/* Returns how often word was picked after first. */
+static unsigned pair_count(const char *first, const char *word)
+{
+	int i = pair_lower(first, word);
+
+	if (i < npairs && !strcmp(pairs[i].first, first) &&
+	    !strcmp(pairs[i].word, word))
+		return pairs[i].count;
+	return 0;
+}
+
+/* Copies a word into buf in lower case. Returns -1 if it is too long. */
+static int complete_word(const char *text, int len, char *buf)
+{
+	if (len < 1 || len > COMPLETE_MAX_WORD)
+		return -1;
+	for (int i = 0; i < len; i++)
+		buf[i] = tolower((unsigned char)text[i]);
+	buf[len] = '\0';
+	return 0;
+}
+
+/* Opens ~/.filename, or else /etc/filename, for reading. */
+static int complete_open(const char *filename)
+{
+	char path[512];
+	char *home = getenv("HOME");
+	int fd;
+
+	if (home != NULL) {
+		snprintf(path, sizeof(path), "%s/.%s", home, filename);
+		if ((fd = open(path, O_RDONLY)) >= 0)
+			return fd;
+	}
+
+	snprintf(path, sizeof(path), "/etc/%s", filename);
+	return open(path, O_RDONLY);
+}
+
+/*
+ * Map the trie file. Its pages are only read as lookups reach them,
+ *  though the kernel is asked to start reading ahead at once.
+ */
+static void complete_map_trie()
+{
+	struct stat st;
+
+	int fd = complete_open(COMPLETE_TRIE_FILENAME);
+	if (fd < 0)
+		return;
+	if (fstat(fd, &st) < 0 || st.st_size < sizeof(struct complete_trie_header)) {
+		close(fd);
+		return;
+	}
+
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return;
+
+	const struct complete_trie_header *h = map;
+	size_t nodes = sizeof(*h);
+	size_t words = nodes + (size_t)h->nnodes * sizeof(struct complete_trie_node);
+	size_t text  = words + (size_t)h->nwords * sizeof(struct complete_trie_word);
+
+	if (memcmp(h->magic, COMPLETE_TRIE_MAGIC, sizeof(h->magic)) ||
+	    h->nnodes < 1 || h->ntext < 1 || text + h->ntext != st.st_size ||
+	    ((const char *)map)[st.st_size - 1] != '\0') {
+		fprintf(stderr, " Ignoring %s, which is not a word trie; "
+		        "rebuild it with mousepad-words.\n", COMPLETE_TRIE_FILENAME);
+		munmap(map, st.st_size);
+		return;
+	}
+
+	madvise(map, st.st_size, MADV_WILLNEED);
+	trie = h;
+	trie_nodes = (const struct complete_trie_node *)((const char *)map + nodes);
+	trie_words = (const struct complete_trie_word *)((const char *)map + words);
+	trie_text  = (const char *)map + text;
+}
+
+/*
+ * Read the learned file: "word count" lines for words that were picked,
+ *  and "word next count" lines for picks that came after another word.
+ */
+static void complete_read_learned(const char *path)
+{
+	char line[2 * COMPLETE_MAX_WORD + 32];
+	char a[COMPLETE_MAX_WORD + 1], b[COMPLETE_MAX_WORD + 1];
+	char *tok[3];
+
+	FILE *f = fopen(path, "r");
+	if (f == NULL)
+		return;
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		int n = 0;
+		for (char *t = strtok(line, " \t\n"); t && n < 3;
+		     t = strtok(NULL, " \t\n"))
+			tok[n++] = t;
+
+		if (n < 2 || complete_word(tok[0], strlen(tok[0]), a) < 0)
+			continue;
+		unsigned count = strtoul(tok[n - 1], NULL, 10);
+
+		if (n == 2)
+			learned_add(a, count);
+		else if (complete_word(tok[1], strlen(tok[1]), b) == 0)
+			pair_add(a, b, count);
+	}
+
+	fclose(f);
+}
+
+/*
+ * Write a snapshot of the learned counts, readable only by its owner,
+ *  replacing the old file all at once.
+ */
+static void complete_save(const struct learned_word *w, int nw,
+                          const struct learned_pair *p, int np)
+{
+	char tmp[sizeof(learned_path) + 4];
+
+	snprintf(tmp, sizeof(tmp), "%s.new", learned_path);
+	int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	FILE *f = (fd >= 0) ? fdopen(fd, "w") : NULL;
+	if (f == NULL) {
+		fprintf(stderr, " Could not write %s: %s.\n", tmp, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return;
+	}
+
+	for (int i = 0; i < nw; i++)
+		fprintf(f, "%s %u\n", w[i].text, w[i].count);
+	for (int i = 0; i < np; i++)
+		fprintf(f, "%s %s %u\n", p[i].first, p[i].word, p[i].count);
+
+	if (fclose(f) != 0 || rename(tmp, learned_path) < 0) {
+		fprintf(stderr, " Could not write %s: %s.\n", learned_path,
+		        strerror(errno));
+		unlink(tmp);
+	}
+}
+
+/*
+ * Wait for picks, then a few seconds more for any that follow, and
+ *  write them all out, away from the thread that handles input.
+ */
+static void *complete_saver(void *arg)
+{
+	static struct learned_word w[COMPLETE_MAX_LEARNED];
+	static struct learned_pair p[COMPLETE_MAX_LEARNED];
+
+	pthread_mutex_lock(&lock);
+	while (1) {
+		while (!dirty)
+			pthread_cond_wait(&picked, &lock);
+
+		struct timespec t = clock_timespec(clock_nsec() +
+		                                   COMPLETE_SAVE_SECONDS * NSEC_PER_SEC);
+		while (pthread_cond_timedwait(&picked, &lock, &t) != ETIMEDOUT)
+			;
+
+		int nw = nlearned, np = npairs;
+		memcpy(w, learned, nw * sizeof(struct learned_word));
+		memcpy(p, pairs, np * sizeof(struct learned_pair));
+		dirty = 0;
+		pthread_mutex_unlock(&lock);
+
+		complete_save(w, nw, p, np);
+
+		pthread_mutex_lock(&lock);
+	}
+
+	return NULL;
+}
+
+/*
+ * Map the trie, read what was learned before, and start the thread
+ *  that keeps it. Completion goes without what can't be found.
+ */
+int complete_init()
+{
+	pthread_condattr_t attr;
+	char *home = getenv("HOME");
+
+	bigram_weight = config_float("completion_bigram_weight", COMPLETE_BIGRAM_WEIGHT);
+	complete_map_trie();
+
+	if (home == NULL)
+		return 0;
+	snprintf(learned_path, sizeof(learned_path), "%s/.%s", home,
+	         COMPLETE_LEARNED_FILENAME);
+	complete_read_learned(learned_path);
+
+	/* Saves are timed on the same clock as everything else. */
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&picked, &attr);
+	pthread_condattr_destroy(&attr);
+
+	if (pthread_create(&saver, NULL, complete_saver, NULL) != 0) {
+		learned_path[0] = '\0';
+		return -1;
+	}
+	return 0;
+}
+
+/* Forget the word being typed, as when the text cursor may have moved. */
+void complete_reset()
+{
+	nshadow = 0;
+	prev[0] = '\0';
+	nchoices = 0;
+}
+
+/*
+ * The word being typed is finished: remember it as prev, if it is a
+ *  known word. Nothing is learned from it.
+ */
+static void complete_finish()
+{
+	prev[0] = '\0';
+
+	if (nshadow >= 1 && nshadow <= COMPLETE_MAX_WORD) {
+		shadow[nshadow] = '\0';
+		if (trie_has(shadow) || learned_find(shadow))
+			strcpy(prev, shadow);
+	}
+
+	nshadow = 0;
+}
+
+/* Offer a word, if it is better than the candidates so far. */
+static void complete_consider(const char *text, unsigned count, double *scores)
+{
+	if (strlen(text) <= nshadow)
+		return;
+	for (int i = 0; i < nchoices; i++)
+		if (!strcmp(choices[i], text))
+			return;
+
+	double score = count;
+	if (prev[0])
+		score += bigram_weight * pair_count(prev, text);
+
+	int i = nchoices;
+	if (i == COMPLETE_CHOICES) {
+		if (score <= scores[i - 1])
+			return;
+		i--;
+	} else {
+		nchoices++;
+	}
+
+	for (; i > 0 && scores[i - 1] < score; i--) {
+		strcpy(choices[i], choices[i - 1]);
+		scores[i] = scores[i - 1];
+	}
+	strcpy(choices[i], text);
+	scores[i] = score;
+}
+
+/* Returns how common a word is, and how often it was picked. */
+static unsigned complete_count(const char *text)
+{
+	const struct learned_word *l = learned_find(text);
+	return l ? l->base + l->count : trie_count(text);
+}
+
+/* Rank the candidates for the word being typed. */
+static void complete_rank()
+{
+	double scores[COMPLETE_CHOICES];
+
+	nchoices = 0;
+	if (nshadow > COMPLETE_MAX_WORD || (nshadow == 0 && !prev[0]))
+		return;
+	shadow[nshadow] = '\0';
+
+	int n = trie_walk(shadow, nshadow);
+	for (int i = 0; n >= 0 && i < COMPLETE_TOP; i++) {
+		const char *text = trie_word_text(trie_nodes[n].top[i]);
+		if (text == NULL)
+			break;
+		complete_consider(text, complete_count(text), scores);
+	}
+
+	/* Picked words, even if rarely used otherwise. */
+	for (int i = learned_lower(shadow); i < nlearned &&
+	     !strncmp(learned[i].text, shadow, nshadow); i++)
+		complete_consider(learned[i].text, learned[i].base + learned[i].count,
+		                  scores);
+
+	/* Words that have been picked after the previous one. */
+	if (prev[0])
+		for (int i = pair_lower(prev, shadow); i < npairs &&
+		     !strcmp(pairs[i].first, prev) &&
+		     !strncmp(pairs[i].word, shadow, nshadow); i++)
+			complete_consider(pairs[i].word, complete_count(pairs[i].word),
+			                  scores);
+}
+
+/*
+ * Follow a key that was typed. modified is nonzero if Ctrl, Alt or Super
+ *  was held, which makes it a command rather than text.
+ */
+void complete_key(KeySym key, int modified)
+{
+	if (modified) {
+		complete_reset();
+	} else if ((key >= XK_a && key <= XK_z) || (key >= XK_A && key <= XK_Z) ||
+	           key == XK_apostrophe) {
+		if (nshadow < COMPLETE_MAX_WORD)
+			shadow[nshadow++] = tolower(key);
+		else
+			nshadow = COMPLETE_MAX_WORD + 1;
+	} else if (key == XK_BackSpace) {
+		if (nshadow > 0 && nshadow <= COMPLETE_MAX_WORD)
+			nshadow--;
+		else
+			complete_reset();
+	} else if (key == XK_space) {
+		complete_finish();
+	} else if ((key > XK_space && key <= XK_asciitilde) ||
+	           key == XK_Return || key == XK_Tab) {
+		/* Punctuation ends the word, and the sentence with it. */
+		complete_finish();
+		prev[0] = '\0';
+	} else {
+		complete_reset();
+	}
+
+	complete_rank();
+}
+
+/* Fills words with the current candidates, best first. Returns how many. */
+int complete_candidates(const char **out, int max)
+{
+	int n = (nchoices < max) ? nchoices : max;
+
+	for (int i = 0; i < n; i++)
+		out[i] = choices[i];
+	return n;
+}
+
+/*
+ * A candidate was picked: count it, and that it followed the previous
+ *  word, and have the counts written out soon. Call before typing the
+ *  rest of it.
+ */
+void complete_accept(int choice)
+{
+	if (choice < 0 || choice >= nchoices)
+		return;
+
+	pthread_mutex_lock(&lock);
+	learned_add(choices[choice], 1);
+	if (prev[0])
+		pair_add(prev, choices[choice], 1);
+	if (learned_path[0]) {
+		dirty = 1;
+		pthread_cond_signal(&picked);
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+/* Returns what is left to type of a candidate, or NULL if there is none. */
+const char *complete_suffix(int choice)
+{
+	if (choice < 0 || choice >= nchoices)
+		return NULL;
+	return choices[choice] + nshadow;
+}
@@ -0,0 +1,88 @@
+/*
+ * complete.h
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __mousepad_complete_h__
+#define __mousepad_complete_h__
+
+#include <stdint.h>
+
+#include <X11/X.h>
+
+#define COMPLETE_TRIE_FILENAME "mousepad.trie"
+#define COMPLETE_LEARNED_FILENAME "mousepad.learned"
+
+/* Candidates offered at once, and the longest word that is tracked. */
+#define COMPLETE_CHOICES  3
+#define COMPLETE_MAX_WORD 32
+
+/* Most words, and most pairs of words, kept in the learned file. */
+#define COMPLETE_MAX_LEARNED 2000
+
+/* Picks are written out together, this long after the first of them. */
+#define COMPLETE_SAVE_SECONDS 5
+
+/* Default for the completion_bigram_weight setting. */
+#define COMPLETE_BIGRAM_WEIGHT 4.0
+
+/*
+ * The trie file, as written by mousepad-words: a header, then nnodes
+ *  nodes, nwords words and ntext bytes of NUL-terminated word text.
+ *  Node 0 is the root. Words are lower case letters and apostrophes,
+ *  in order, and the children of a node are consecutive, in order of c.
+ * Integers are in the byte order of the machine that wrote the file.
+ */
+#define COMPLETE_TRIE_MAGIC "MPTRIE1"
+
+/*
+ * Candidates kept at each trie node, best first. No more are needed than
+ *  are offered, since picked words are ranked from the learned counts.
+ */
+#define COMPLETE_TOP COMPLETE_CHOICES
+
+struct complete_trie_header
+{
+	char magic[8];
+	uint32_t nnodes, nwords, ntext;
+};
+
+struct complete_trie_node
+{
+	uint32_t child;     /* First child, if there are any. */
+	uint8_t nchildren;
+	char c;
+	uint16_t unused;
+	int32_t word;       /* The word ending here, or -1. */
+	int32_t top[COMPLETE_TOP]; /* Most used words below, or -1. */
+};
+
+struct complete_trie_word
+{
+	uint32_t text;  /* Offset into the text. */
+	uint32_t count; /* How common the word is. */
+};
+
+int complete_init();
+void complete_reset();
+void complete_key(KeySym key, int modified);
+int complete_candidates(const char **words, int max);
+const char *complete_suffix(int choice);
+void complete_accept(int choice);
+
+#endif /* __mousepad_complete_h__ */
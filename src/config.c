@@ -19,32 +19,65 @@
  */
 
 #include "config.h"
+#include "layout.h"
 #include "mousepad.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
 
+#define SETTINGS_LINE_LENGTH 512
+#define SETTINGS_MAX 256
+
 /*
- * Look for the configuration file, first in ~/.CONFIG_FILENAME,
- *  then in /etc/CONFIG_FILENAME.
+ * Settings read from the settings file, as "key value" pairs.
+ * Those after a "[name]" line belong to that section, and only apply
+ *  while it is selected; those before any section always apply.
+ */
+static struct
+{
+	char *section; /* NULL outside any section. */
+	char *key;
+	char *value;
+} settings[SETTINGS_MAX];
+static int nsettings = 0;
+
+static const char *selected = NULL; /* Section looked in first, if any. */
+
+/*
+ * Look for a file, first in ~/.filename, then in /etc/filename.
  * Returns NULL if neither file exists or if fopen() fails.
  */
-FILE *config_open()
+static FILE *config_fopen(const char *filename)
 {
 	char *home = getenv("HOME");
 	if (home != NULL) {
 		FILE *f;
-		char *path = alloca(strlen(home) + strlen("/."CONFIG_FILENAME) + 1);
+		char *path = alloca(strlen(home) + strlen("/.") + strlen(filename) + 1);
 		strcpy(path, home);
-		strcat(path, "/."CONFIG_FILENAME);
+		strcat(path, "/.");
+		strcat(path, filename);
 		
 		if ((f = fopen(path, "r")) != NULL)
 			return f;
 	}
 
-	return fopen("/etc/"CONFIG_FILENAME, "r");
+	char *path = alloca(strlen("/etc/") + strlen(filename) + 1);
+	strcpy(path, "/etc/");
+	strcat(path, filename);
+	return fopen(path, "r");
+}
+
+/*
+ * Look for the configuration file, first in ~/.CONFIG_FILENAME,
+ *  then in /etc/CONFIG_FILENAME.
+ * Returns NULL if neither file exists or if fopen() fails.
+ */
+FILE *config_open()
+{
+	return config_fopen(CONFIG_FILENAME);
 }
 
 /* Close the configuration file. */
@@ -91,3 +124,117 @@ int config_read(FILE *f, int n, int *joymap)
 	return 0;
 }
 
+
+/*
+ * Look for the settings file, first in ~/.SETTINGS_FILENAME,
+ *  then in /etc/SETTINGS_FILENAME.
+ * Returns NULL if neither file exists or if fopen() fails.
+ */
+FILE *config_settings_open()
+{
+	return config_fopen(SETTINGS_FILENAME);
+}
+
+/*
+ * Read "key value" lines from the settings file.
+ * The value is the rest of the line, up to any '#' comment.
+ * Returns -1 on a line with a key but no value.
+ */
+int config_settings_read(FILE *f)
+{
+	char line[SETTINGS_LINE_LENGTH];
+	char *section = NULL;
+
+	for (int lineno = 1; fgets(line, sizeof(line), f) != NULL; lineno++) {
+		char *key = line + strspn(line, " \t");
+		if (*key == '#' || *key == '\n' || *key == '\r' || *key == '\0')
+			continue;
+
+		if (*key == '[') {
+			char *end = strchr(key, ']');
+			if (end == NULL || end == key + 1) {
+				fprintf(stderr, " Bad section name on line %d.\n", lineno);
+				return -1;
+			}
+			*end = '\0';
+			section = strdup(key + 1);
+			continue;
+		}
+
+		char *value = key + strcspn(key, " \t\r\n");
+		if (*value == '\n' || *value == '\r' || *value == '\0') {
+			fprintf(stderr, " Setting on line %d has no value.\n", lineno);
+			return -1;
+		}
+		*value++ = '\0';
+		value += strspn(value, " \t");
+		value[strcspn(value, "#\r\n")] = '\0';
+		char *end = value + strlen(value);
+		while (end > value && (end[-1] == ' ' || end[-1] == '\t'))
+			*--end = '\0';
+
+		if (nsettings == SETTINGS_MAX)
+			return -1;
+		settings[nsettings].section = section;
+		settings[nsettings].key = strdup(key);
+		settings[nsettings].value = strdup(value);
+		nsettings++;
+	}
+
+	return 0;
+}
+
+/* Returns nonzero if the settings file has a section with this name. */
+int config_has_section(const char *name)
+{
+	for (int i = 0; i < nsettings; i++)
+		if (settings[i].section && !strcasecmp(settings[i].section, name))
+			return 1;
+	return 0;
+}
+
+/*
+ * Look up settings in the named section before the unsectioned ones,
+ *  or only in the unsectioned ones if name is NULL.
+ */
+void config_section(const char *name)
+{
+	selected = name;
+}
+
+/* Returns the value of a setting, or def if it is not set. */
+const char *config_string(const char *key, const char *def)
+{
+	/* Later lines override earlier ones. */
+	if (selected != NULL) {
+		for (int i = nsettings - 1; i >= 0; i--)
+			if (settings[i].section &&
+			    !strcasecmp(settings[i].section, selected) &&
+			    !strcmp(settings[i].key, key))
+				return settings[i].value;
+	}
+
+	for (int i = nsettings - 1; i >= 0; i--)
+		if (settings[i].section == NULL && !strcmp(settings[i].key, key))
+			return settings[i].value;
+	return def;
+}
+
+int config_int(const char *key, int def)
+{
+	const char *value = config_string(key, NULL);
+	return value ? atoi(value) : def;
+}
+
+double config_float(const char *key, double def)
+{
+	const char *value = config_string(key, NULL);
+	return value ? atof(value) : def;
+}
+
+/* Returns the button named by a setting; "none" gives 0. */
+button_t config_button(const char *key, button_t def)
+{
+	const char *value = config_string(key, NULL);
+	return value ? layout_button(value) : def;
+}
@@ -20,9 +20,12 @@
 
 #ifndef __mousepad_config_h__
 
+#include "mousepad.h"
+
 #include <stdio.h>
 
 #define CONFIG_FILENAME "mousepad.conf"
+#define SETTINGS_FILENAME "mousepadrc"
 
 /* Joystick configuration mapping from JEvent to button. */
 struct btnconfig
@@ -35,5 +38,14 @@ FILE *config_open();
 int config_read(FILE *f, int n, int *joymap);
 int config_close();
 
+FILE *config_settings_open();
+int config_settings_read(FILE *f);
+int config_has_section(const char *name);
+void config_section(const char *name);
+const char *config_string(const char *key, const char *def);
+int config_int(const char *key, int def);
+double config_float(const char *key, double def);
+button_t config_button(const char *key, button_t def);
+
 #endif /* __mousepad_config_h__ */
 
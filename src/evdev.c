@@ -0,0 +1,93 @@
+/*
+ * evdev.c
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "evdev.h"
+
+#include <string.h>
+#include <sys/ioctl.h>
+
+/* Returns nonzero if fd is an evdev (/dev/input/eventN) device. */
+int evdev_probe(int fd)
+{
+	int version;
+	return ioctl(fd, EVIOCGVERSION, &version) >= 0;
+}
+
+/*
+ * Number the device's keys the way the kernel's joydev driver does,
+ *  so that a configuration file written for /dev/input/jsN
+ *  also fits the matching /dev/input/eventN, and vice versa.
+ * joydev only exposes codes from BTN_MISC upwards; any lower KEY_ codes
+ *  are numbered after those, so pads that report keyboard keys still work.
+ *
+ * keymap[code] is set to the button number, or -1 if the device lacks code.
+ * Returns the number of buttons, or -1 on error.
+ */
+int evdev_keymap(int fd, short *keymap)
+{
+	unsigned long keybits[NLONGS(KEY_MAX + 1)];
+	int n = 0;
+
+	memset(keybits, 0x0, sizeof(keybits));
+	if (ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keybits)), keybits) < 0)
+		return -1;
+
+	for (int i = 0; i < EVDEV_KEYMAP_SIZE; i++)
+		keymap[i] = -1;
+
+	for (int i = BTN_JOYSTICK; i <= KEY_MAX; i++)
+		if (TEST_BIT(i, keybits))
+			keymap[i] = n++;
+	for (int i = BTN_MISC; i < BTN_JOYSTICK; i++)
+		if (TEST_BIT(i, keybits))
+			keymap[i] = n++;
+	for (int i = 0; i < BTN_MISC; i++)
+		if (TEST_BIT(i, keybits))
+			keymap[i] = n++;
+
+	return n;
+}
+
+/*
+ * Number the device's absolute axes in code order, as joydev does.
+ * absmap[code] is set to the axis number, or -1 if the device lacks code,
+ *  and absinfo[code] to the range the device reports for it.
+ * Returns the number of axes, or -1 on error.
+ */
+int evdev_absmap(int fd, short *absmap, struct input_absinfo *absinfo)
+{
+	unsigned long absbits[NLONGS(ABS_MAX + 1)];
+	int n = 0;
+
+	memset(absbits, 0x0, sizeof(absbits));
+	if (ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(absbits)), absbits) < 0)
+		return -1;
+
+	for (int i = 0; i < EVDEV_ABSMAP_SIZE; i++) {
+		absmap[i] = -1;
+		if (!TEST_BIT(i, absbits))
+			continue;
+		if (ioctl(fd, EVIOCGABS(i), &absinfo[i]) < 0)
+			continue;
+		absmap[i] = n++;
+	}
+
+	return n;
+}
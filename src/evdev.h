@@ -0,0 +1,41 @@
+/*
+ * evdev.h
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __mousepad_evdev_h__
+#define __mousepad_evdev_h__
+
+#include <linux/input.h>
+
+/* Length of the map built by evdev_keymap(), indexed by key code. */
+#define EVDEV_KEYMAP_SIZE (KEY_MAX + 1)
+
+/* Length of the map built by evdev_absmap(), indexed by axis code. */
+#define EVDEV_ABSMAP_SIZE (ABS_MAX + 1)
+
+#define BITS_PER_LONG (sizeof(long) * 8)
+#define NLONGS(x) (((x) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+#define TEST_BIT(bit, array) \
+	((array[(bit) / BITS_PER_LONG] >> ((bit) % BITS_PER_LONG)) & 1)
+
+int evdev_probe(int fd);
+int evdev_keymap(int fd, short *keymap);
+int evdev_absmap(int fd, short *absmap, struct input_absinfo *absinfo);
+
+#endif /* __mousepad_evdev_h__ */
@@ -0,0 +1,415 @@
+/*
+ * gesture.c
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gesture.h"
+#include "clock.h"
+#include "config.h"
+
+#include <stddef.h>
+
+/*
+ * The gesture engine sits between the pad and the current mode's
+ *  event handler, watching the timestamped stream of button changes.
+ *
+ * Feet never land on two arrows at exactly the same time, so a press
+ *  that could begin a chord is held back for at most the chord window.
+ *  If the rest of the chord arrives in time, its action runs and the
+ *  presses are swallowed; otherwise the held-back presses are replayed
+ *  to the handler, in order. Presses of buttons that belong to no chord
+ *  are never delayed.
+ *
+ * A handler that can take back what it did may instead ask for
+ *  speculation: possible chord members are handed on at once, and if
+ *  the chord completes after all, the handler is told to roll them back
+ *  before the chord's action runs. Lone presses then cost no latency.
+ *
+ * Releases of swallowed presses are swallowed too, so the handler
+ *  always sees matched press and release pairs.
+ *
+ * A mode may name a hybrid button: while it is held, another mode lends
+ *  its gesture table and handler, and presses go to those instead.
+ *  One set of visible buttons is kept for both handlers, split by who
+ *  saw each press, and a release always goes where its press went.
+ */
+
+struct gesture_set
+{
+	const struct gesture *table;
+	int n;
+	gesture_fallback_t fallback;
+	gesture_rollback_t rollback; /* Set if presses are speculated. */
+};
+
+static struct gesture_set home; /* The mode's own gestures. */
+static struct gesture_set lent; /* Borrowed while the hybrid button is held. */
+static struct gesture_set *active = &home;
+
+static button_t hybrid;
+static gesture_hybrid_t hybrid_notify;
+
+static long long chord_window, doubletap_window, hold_time;
+
+static buttonstate_t visible;    /* Buttons the handlers have seen pressed. */
+static buttonstate_t borrowed;   /* Those the lent handler saw pressed. */
+static buttonstate_t solo;       /* Held buttons no other press overlapped. */
+static buttonstate_t hold_fired; /* Held buttons whose hold action ran. */
+static long long pressed_at[NBUTTONS];
+static long long tapped_at[NBUTTONS]; /* Release time of a tap, or 0. */
+
+/* Presses held back while a chord may be forming. */
+static button_t pending[NBUTTONS];
+static int npending;
+static buttonstate_t pending_set;
+static long long pending_deadline;
+
+static buttonstate_t acting; /* Buttons of the gesture whose action runs. */
+static int passed;           /* That action had nothing to do with them. */
+
+/* Read timing from the settings file. */
+void gesture_init()
+{
+	chord_window = config_int("chord_window", GESTURE_CHORD_MILLISECONDS)
+	               * NSEC_PER_MSEC;
+	doubletap_window = config_int("doubletap_window",
+	                              GESTURE_DOUBLETAP_MILLISECONDS) * NSEC_PER_MSEC;
+	hold_time = config_int("hold_time", GESTURE_HOLD_MILLISECONDS)
+	            * NSEC_PER_MSEC;
+}
+
+/*
+ * Switch to another gesture table and handler, as when the mode changes.
+ * The new handler has seen no presses yet, so buttons still held
+ *  stay invisible to it until they are pressed again, and their
+ *  releases are not taps.
+ */
+void gesture_use(const struct gesture *t, int n, gesture_fallback_t f)
+{
+	home.table = t;
+	home.n = n;
+	home.fallback = f;
+	home.rollback = NULL;
+	active = &home;
+	hybrid = 0;
+
+	visible = 0;
+	borrowed = 0;
+	solo = 0;
+	npending = 0;
+	pending_set = 0;
+}
+
+/*
+ * Hand possible chord members to the handler straight away,
+ *  calling r to undo them if they do form a chord.
+ * Lasts until the next gesture_use().
+ */
+void gesture_speculate(gesture_rollback_t r)
+{
+	home.rollback = r;
+}
+
+/*
+ * While button is held, use gestures lent by another mode instead.
+ * notify is told when it is pressed and released; on a press, it must
+ *  call gesture_borrow() with the gestures to use.
+ * Lasts until the next gesture_use().
+ */
+void gesture_hybrid(button_t button, gesture_hybrid_t notify)
+{
+	hybrid = button;
+	hybrid_notify = notify;
+}
+
+/* Lend a gesture table and handler, for as long as the hybrid button is held. */
+void gesture_borrow(const struct gesture *t, int n, gesture_fallback_t f)
+{
+	lent.table = t;
+	lent.n = n;
+	lent.fallback = f;
+	lent.rollback = NULL;
+}
+
+static const struct gesture *gesture_find(int type, buttonstate_t buttons,
+                                          button_t second)
+{
+	const struct gesture *table = active->table;
+
+	for (int i = 0; i < active->n; i++)
+		if (table[i].type == type && table[i].buttons == buttons &&
+		    table[i].second == second)
+			return &table[i];
+	return NULL;
+}
+
+static void gesture_forward(button_t button, int pressed);
+
+/*
+ * Run a gesture's action, made by the given buttons.
+ * If the action passes, those still held are handed on as plain presses,
+ *  in button order.
+ */
+static void gesture_run(const struct gesture *g, buttonstate_t buttons)
+{
+	acting = buttons;
+	passed = 0;
+	g->action(g->arg);
+	acting = 0;
+
+	if (passed) {
+		passed = 0;
+		for (int i = 0; i < NBUTTONS; i++)
+			if (buttons & (1 << i))
+				gesture_forward(1 << i, 1);
+	}
+}
+
+/*
+ * Called by an action that turns out to have nothing to do, so that
+ *  the presses that made its gesture go to the handler instead.
+ */
+void gesture_pass()
+{
+	passed = 1;
+}
+
+/*
+ * Returns the buttons that made the gesture whose action is running,
+ *  while they are still held, for actions that last as long as they do.
+ * Returns 0 outside of an action, and for taps.
+ */
+buttonstate_t gesture_acting()
+{
+	return acting;
+}
+
+/* Returns nonzero if some chord contains every button in set, and more. */
+static int gesture_chord_grows(buttonstate_t set)
+{
+	const struct gesture *table = active->table;
+
+	for (int i = 0; i < active->n; i++)
+		if (table[i].type == GESTURE_CHORD &&
+		    (table[i].buttons & set) == set && table[i].buttons != set)
+			return 1;
+	return 0;
+}
+
+/*
+ * Hand a button change on to the handler in use, or for a release,
+ *  to the one that saw the press.
+ */
+static void gesture_forward(button_t button, int pressed)
+{
+	if (pressed) {
+		visible |= button;
+		if (active == &lent)
+			borrowed |= button;
+	} else {
+		visible &= ~button;
+	}
+
+	struct gesture_set *set = (borrowed & button) ? &lent : &home;
+	buttonstate_t seen = visible & ((set == &lent) ? borrowed : ~borrowed);
+
+	if (!pressed)
+		borrowed &= ~button;
+
+	if (set->fallback)
+		set->fallback(seen, button);
+}
+
+/*
+ * Settle a forming chord: run it if complete, or else replay its presses.
+ * Speculated presses were handed on already, and are only rolled back
+ *  if the chord does complete.
+ */
+static void gesture_resolve()
+{
+	const struct gesture *g = gesture_find(GESTURE_CHORD, pending_set, 0);
+	buttonstate_t set = pending_set;
+	int n = npending;
+
+	npending = 0;
+	pending_set = 0;
+
+	if (g) {
+		buttonstate_t undone = visible & set;
+		visible &= ~set;
+		borrowed &= ~set;
+		if (undone)
+			active->rollback(undone, pending[0]);
+		gesture_run(g, set);
+		return;
+	}
+
+	for (int i = 0; i < n; i++)
+		if (!(visible & pending[i]))
+			gesture_forward(pending[i], 1);
+}
+
+static void gesture_press(buttonstate_t buttons, button_t changed, long long time)
+{
+	const struct gesture *g;
+	int i = button_index(changed);
+	long long tapped = tapped_at[i];
+
+	/* A button is alone only if nothing else is held with it. */
+	solo = (buttons == changed) ? changed : 0;
+	pressed_at[i] = time;
+	tapped_at[i] = 0;
+
+	/* The hybrid button switches gestures, and is never handed on. */
+	if (changed == hybrid && active == &home) {
+		if (npending)
+			gesture_resolve();
+		hybrid_notify(1);
+		active = &lent;
+		return;
+	}
+
+	/* The last press of this button was a tap, just now. */
+	if (tapped && time - tapped <= doubletap_window &&
+	    (g = gesture_find(GESTURE_DOUBLETAP, changed, 0))) {
+		if (npending)
+			gesture_resolve();
+		gesture_run(g, changed);
+		return;
+	}
+
+	/* Another button was tapped just before this one. */
+	for (int j = 0; j < NBUTTONS; j++) {
+		if (!tapped_at[j] || time - tapped_at[j] > doubletap_window)
+			continue;
+		if ((g = gesture_find(GESTURE_SEQUENCE, 1 << j, changed))) {
+			tapped_at[j] = 0;
+			if (npending)
+				gesture_resolve();
+			gesture_run(g, changed);
+			return;
+		}
+	}
+
+	if (buttons == changed && (g = gesture_find(GESTURE_PRESS, changed, 0))) {
+		gesture_run(g, changed);
+		return;
+	}
+
+	/* Hold back presses that may be the start of a chord. */
+	if (npending || gesture_chord_grows(changed)) {
+		if (!npending)
+			pending_deadline = time + chord_window;
+		pending[npending++] = changed;
+		pending_set |= changed;
+
+		/* Settle as soon as no larger chord can form. */
+		if (!gesture_chord_grows(pending_set))
+			gesture_resolve();
+		else if (active->rollback)
+			gesture_forward(changed, 1);
+		return;
+	}
+
+	gesture_forward(changed, 1);
+}
+
+static void gesture_release(button_t changed, long long time)
+{
+	const struct gesture *g = NULL;
+	int i = button_index(changed);
+
+	if ((pending_set & changed) || (changed == hybrid && npending))
+		gesture_resolve();
+
+	if (changed == hybrid && active == &lent) {
+		active = &home;
+		hybrid_notify(0);
+	}
+
+	/* A short press with nothing else held is a tap. */
+	if ((solo & changed) && !(hold_fired & changed) &&
+	    time - pressed_at[i] <= hold_time) {
+		tapped_at[i] = time;
+		g = gesture_find(GESTURE_TAP, changed, 0);
+	}
+
+	solo &= ~changed;
+	hold_fired &= ~changed;
+
+	if (visible & changed)
+		gesture_forward(changed, 0);
+
+	if (g)
+		gesture_run(g, 0);
+}
+
+/* Feed one button change, with the time at which it happened. */
+void gesture_event(buttonstate_t buttons, button_t changed, long long time)
+{
+	if (!changed) return;
+
+	if (buttons & changed)
+		gesture_press(buttons, changed, time);
+	else
+		gesture_release(changed, time);
+}
+
+/*
+ * Returns nonzero and sets when to the time gesture_tick() is next needed,
+ *  or returns 0 if nothing is waiting on time.
+ */
+int gesture_deadline(long long *when)
+{
+	int waiting = 0;
+
+	if (npending) {
+		*when = pending_deadline;
+		waiting = 1;
+	}
+
+	for (int i = 0; i < NBUTTONS; i++) {
+		button_t b = 1 << i;
+		if (!(solo & b) || (hold_fired & b) || !gesture_find(GESTURE_HOLD, b, 0))
+			continue;
+		if (!waiting || pressed_at[i] + hold_time < *when)
+			*when = pressed_at[i] + hold_time;
+		waiting = 1;
+	}
+
+	return waiting;
+}
+
+/* Handle gestures that complete by the passing of time. */
+void gesture_tick(long long now)
+{
+	const struct gesture *g;
+
+	if (npending && now >= pending_deadline)
+		gesture_resolve();
+
+	for (int i = 0; i < NBUTTONS; i++) {
+		button_t b = 1 << i;
+		if (!(solo & b) || (hold_fired & b) || now - pressed_at[i] < hold_time)
+			continue;
+		if ((g = gesture_find(GESTURE_HOLD, b, 0))) {
+			hold_fired |= b;
+			gesture_run(g, b);
+		}
+	}
+}
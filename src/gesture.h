@@ -0,0 +1,76 @@
+/*
+ * gesture.h
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __mousepad_gesture_h__
+#define __mousepad_gesture_h__
+
+#include "mousepad.h"
+
+/* Gesture types. */
+#define GESTURE_PRESS     0 /* The button is pressed while no other is held. */
+#define GESTURE_CHORD     1 /* All buttons are pressed within the chord window. */
+#define GESTURE_TAP       2 /* The button is pressed and released on its own. */
+#define GESTURE_DOUBLETAP 3 /* The button is tapped, then pressed again soon. */
+#define GESTURE_HOLD      4 /* The button is held on its own for the hold time. */
+#define GESTURE_SEQUENCE  5 /* The button is tapped, then second is pressed soon. */
+
+/* Default timing, in milliseconds; each is overridable in the settings file. */
+#define GESTURE_CHORD_MILLISECONDS     50
+#define GESTURE_DOUBLETAP_MILLISECONDS 300
+#define GESTURE_HOLD_MILLISECONDS      500
+
+/*
+ * One row of a gesture table: when the gesture is recognized,
+ *  action(arg) runs in place of handing the buttons involved to the
+ *  mode's own event handler.
+ */
+struct gesture
+{
+	int type;              /* One of the GESTURE defines. */
+	buttonstate_t buttons; /* The chord's buttons, or else the one button. */
+	button_t second;       /* For GESTURE_SEQUENCE, the button pressed second. */
+	void (*action)(int arg);
+	int arg;
+};
+
+/* Event handler for button changes that are not part of a gesture. */
+typedef void (*gesture_fallback_t)(buttonstate_t buttons, button_t changed);
+
+/*
+ * Undoes the effects of presses that were handed on speculatively
+ *  but turned out to begin a chord. first is the earliest of them.
+ */
+typedef void (*gesture_rollback_t)(buttonstate_t undone, button_t first);
+
+/* Told when the hybrid button is pressed (held is 1) and released (0). */
+typedef void (*gesture_hybrid_t)(int held);
+
+void gesture_init();
+void gesture_use(const struct gesture *table, int n, gesture_fallback_t fallback);
+void gesture_speculate(gesture_rollback_t rollback);
+void gesture_hybrid(button_t button, gesture_hybrid_t notify);
+void gesture_borrow(const struct gesture *table, int n, gesture_fallback_t fallback);
+buttonstate_t gesture_acting();
+void gesture_pass();
+void gesture_event(buttonstate_t buttons, button_t changed, long long time);
+int gesture_deadline(long long *when);
+void gesture_tick(long long now);
+
+#endif /* __mousepad_gesture_h__ */
@@ -0,0 +1,119 @@
+/*
+ * gridgtk.c
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gridgtk.h"
+
+#include <stdio.h>
+
+#include <gtk/gtk.h>
+
+#define GRID_LINE_WIDTH 3
+
+/*
+ * The grid is a popup window shaped down to its own lines, so that
+ *  whatever is underneath shows through without needing a compositor.
+ * Its input shape is empty: the pointer and clicks pass straight through.
+ * Like the keyboard chart, it is drawn when the main loop next runs GTK.
+ */
+static GtkWidget *window;
+static int window_shown = 0;
+
+/* GTK grid overlay initialization. */
+int gridgtk_init(Display *d)
+{
+	GdkColor color = { 0, 0xffff, 0x4000, 0x0000 };
+
+	if (d == NULL) return -1;
+
+	window = gtk_window_new(GTK_WINDOW_POPUP);
+	if (window == NULL) {
+		fprintf(stderr, " Could not create the grid window.\n");
+		return -1;
+	}
+	gtk_window_stick((GtkWindow *)window);
+	gtk_widget_modify_bg(window, GTK_STATE_NORMAL, &color);
+	gtk_widget_realize(window);
+	if (gtk_widget_get_window(window) == NULL) {
+		fprintf(stderr, " Could not realize the grid window.\n");
+		return -1;
+	}
+
+	/* Never take the pointer. */
+	GdkBitmap *empty = gdk_pixmap_new(NULL, 1, 1, 1);
+	if (empty == NULL) {
+		fprintf(stderr, " Could not create the grid's input shape.\n");
+		return -1;
+	}
+	cairo_t *cr = gdk_cairo_create(empty);
+	cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+	cairo_paint(cr);
+	cairo_destroy(cr);
+	gtk_widget_input_shape_combine_mask(window, empty, 0, 0);
+	g_object_unref(empty);
+
+	return 0;
+}
+
+/* Draw the grid over the given region of the screen. */
+void gridgtk_show(int x, int y, int width, int height)
+{
+	if (width < 3 || height < 3) {
+		gridgtk_hide();
+		return;
+	}
+
+	GdkBitmap *mask = gdk_pixmap_new(NULL, width, height, 1);
+	if (mask == NULL) {
+		gridgtk_hide();
+		return;
+	}
+	cairo_t *cr = gdk_cairo_create(mask);
+
+	cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+	cairo_paint(cr);
+
+	cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+	cairo_set_source_rgba(cr, 1, 1, 1, 1);
+	cairo_set_line_width(cr, GRID_LINE_WIDTH);
+	cairo_rectangle(cr, 0, 0, width, height);
+	for (int i = 1; i < 3; i++) {
+		cairo_move_to(cr, width * i / 3, 0);
+		cairo_line_to(cr, width * i / 3, height);
+		cairo_move_to(cr, 0, height * i / 3);
+		cairo_line_to(cr, width, height * i / 3);
+	}
+	cairo_stroke(cr);
+	cairo_destroy(cr);
+
+	gtk_window_move((GtkWindow *)window, x, y);
+	gtk_window_resize((GtkWindow *)window, width, height);
+	gtk_widget_shape_combine_mask(window, mask, 0, 0);
+	g_object_unref(mask);
+
+	gtk_widget_show(window);
+	window_shown = 1;
+}
+
+void gridgtk_hide()
+{
+	if (!window_shown) return;
+	gtk_widget_hide(window);
+	window_shown = 0;
+}
@@ -0,0 +1,319 @@
+/*
+ * input.c
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "input.h"
+#include "clock.h"
+#include "evdev.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/joystick.h>
+
+/* Device events drained per read(). */
+#define INPUT_EVENT_BATCH 64
+
+#define INPUT_JOYSTICK 0 /* Legacy /dev/input/jsN interface. */
+#define INPUT_EVDEV    1 /* /dev/input/eventN interface. */
+
+static int backend;
+static int fd = -1;
+static int nbuttons;
+static int naxes;
+static const int *joymap; /* Map from button number to button bitfield. */
+static ring_t *ring;
+static pthread_t thread;
+
+/* evdev state, owned by the input thread once started. */
+static short keymap[EVDEV_KEYMAP_SIZE]; /* Key code to button number. */
+static unsigned long keys[NLONGS(KEY_MAX + 1)]; /* Last reported key state. */
+static short absmap[EVDEV_ABSMAP_SIZE]; /* Axis code to axis number. */
+static struct input_absinfo absinfo[EVDEV_ABSMAP_SIZE];
+static int dropped; /* Discarding up to the next SYN_REPORT. */
+
+/*
+ * Open the pad for blocking reads.
+ * Event devices are preferred; joystick devices are still accepted.
+ * If grab is nonzero, an event device is grabbed so that no other client
+ *  (such as the X server) sees its events.
+ * Returns the number of buttons on the device, or -1 on error.
+ */
+int input_open(const char *device, int grab)
+{
+	if ((fd = open(device, O_RDONLY)) < 0)
+		return -1;
+
+	if (evdev_probe(fd)) {
+		backend = INPUT_EVDEV;
+		nbuttons = evdev_keymap(fd, keymap);
+		naxes = evdev_absmap(fd, absmap, absinfo);
+		memset(keys, 0x0, sizeof(keys));
+		dropped = 0;
+
+		/* Stamp events on the same clock as clock_nsec(). */
+		int clock = CLOCK_MONOTONIC;
+		ioctl(fd, EVIOCSCLOCKID, &clock);
+
+		if (grab && ioctl(fd, EVIOCGRAB, 1) < 0)
+			nbuttons = -1;
+	} else {
+		backend = INPUT_JOYSTICK;
+		unsigned char n = 0;
+		nbuttons = 0;
+		ioctl(fd, JSIOCGBUTTONS, &nbuttons);
+		ioctl(fd, JSIOCGAXES, &n);
+		naxes = n;
+	}
+
+	if (nbuttons <= 0) {
+		close(fd);
+		fd = -1;
+		return -1;
+	}
+
+	return nbuttons;
+}
+
+/* Queue a change of button number. Returns nonzero if it was pushed. */
+static int input_push(long long time, int number, int value)
+{
+	struct padevent e;
+
+	if (number < 0 || number >= nbuttons || !joymap[number])
+		return 0;
+
+	e.time   = time;
+	e.type   = PADEVENT_BUTTON;
+	e.button = joymap[number];
+	e.axis   = 0;
+	e.value  = value;
+	ring_push(ring, &e);
+	return 1;
+}
+
+/* Queue a new position of axis number. */
+static void input_push_axis(long long time, int number, int value)
+{
+	struct padevent e;
+
+	if (number < 0 || number >= naxes)
+		return;
+
+	e.time   = time;
+	e.type   = PADEVENT_AXIS;
+	e.button = 0;
+	e.axis   = number;
+	e.value  = value;
+	ring_push(ring, &e);
+}
+
+/* Scale an event device's axis reading to +/- PADEVENT_AXIS_MAX. */
+static int evdev_axis_value(const struct input_absinfo *info, int value)
+{
+	long long half = ((long long)info->maximum - info->minimum) / 2;
+	long long mid = ((long long)info->maximum + info->minimum) / 2;
+
+	if (half <= 0)
+		return 0;
+
+	long long v = (value - mid) * PADEVENT_AXIS_MAX / half;
+	if (v > PADEVENT_AXIS_MAX)  v = PADEVENT_AXIS_MAX;
+	if (v < -PADEVENT_AXIS_MAX) v = -PADEVENT_AXIS_MAX;
+	return v;
+}
+
+/*
+ * Read one batch from a joystick device.
+ * The js interface only has millisecond times, so events are stamped
+ *  when they are read instead. Returns -1 once the device is gone.
+ */
+static int joystick_read()
+{
+	struct js_event jevents[INPUT_EVENT_BATCH];
+
+	ssize_t len = read(fd, jevents, sizeof(jevents));
+	if (len < 0 && errno == EINTR)
+		return 0;
+	if (len <= 0)
+		return -1;
+
+	long long time = clock_nsec();
+	int n = len / sizeof(struct js_event);
+	int pushed = 0;
+	for (int i = 0; i < n; i++) {
+		switch (jevents[i].type & ~JS_EVENT_INIT) {
+			case JS_EVENT_BUTTON:
+				pushed |= input_push(time, jevents[i].number, jevents[i].value);
+				break;
+
+			case JS_EVENT_AXIS:
+				input_push_axis(time, jevents[i].number, jevents[i].value);
+				pushed = 1;
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	if (pushed)
+		ring_signal(ring);
+	return 0;
+}
+
+/*
+ * After the kernel reports SYN_DROPPED, fetch the real key state
+ *  and queue whatever changes were lost.
+ */
+static void evdev_resync(long long time)
+{
+	unsigned long now[NLONGS(KEY_MAX + 1)];
+
+	memset(now, 0x0, sizeof(now));
+	if (ioctl(fd, EVIOCGKEY(sizeof(now)), now) < 0)
+		return;
+
+	for (int code = 0; code <= KEY_MAX; code++) {
+		if (keymap[code] < 0 || TEST_BIT(code, now) == TEST_BIT(code, keys))
+			continue;
+		input_push(time, keymap[code], TEST_BIT(code, now));
+	}
+
+	memcpy(keys, now, sizeof(keys));
+	ring_signal(ring);
+}
+
+/*
+ * Read one batch from an event device.
+ * Events between two SYN_REPORTs form a frame: they share the kernel's
+ *  microsecond timestamp and are handed to the dispatcher all at once.
+ * Returns -1 once the device is gone.
+ */
+static int evdev_read()
+{
+	struct input_event events[INPUT_EVENT_BATCH];
+
+	ssize_t len = read(fd, events, sizeof(events));
+	if (len < 0 && errno == EINTR)
+		return 0;
+	if (len <= 0)
+		return -1;
+
+	int n = len / sizeof(struct input_event);
+	for (int i = 0; i < n; i++) {
+		struct input_event *ev = &events[i];
+		long long time = ev->time.tv_sec * NSEC_PER_SEC +
+		                 ev->time.tv_usec * 1000LL;
+
+		if (ev->type == EV_SYN && ev->code == SYN_DROPPED) {
+			dropped = 1;
+			continue;
+		}
+
+		if (dropped) {
+			if (ev->type == EV_SYN && ev->code == SYN_REPORT) {
+				dropped = 0;
+				evdev_resync(time);
+			}
+			continue;
+		}
+
+		switch (ev->type) {
+			case EV_KEY:
+				/* Ignore autorepeat and keys outside the map. */
+				if (ev->value == 2 || ev->code > KEY_MAX)
+					break;
+				if (ev->value)
+					keys[ev->code / BITS_PER_LONG] |=  (1UL << (ev->code % BITS_PER_LONG));
+				else
+					keys[ev->code / BITS_PER_LONG] &= ~(1UL << (ev->code % BITS_PER_LONG));
+				input_push(time, keymap[ev->code], ev->value);
+				break;
+
+			case EV_ABS:
+				if (ev->code >= EVDEV_ABSMAP_SIZE || absmap[ev->code] < 0)
+					break;
+				input_push_axis(time, absmap[ev->code],
+				                evdev_axis_value(&absinfo[ev->code], ev->value));
+				break;
+
+			case EV_SYN:
+				if (ev->code == SYN_REPORT)
+					ring_signal(ring);
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * The input thread does nothing but sleep in read() on the pad,
+ *  so that button edges are collected and timestamped as soon as
+ *  the kernel has them, regardless of what the dispatcher is doing.
+ */
+static void *input_thread(void *arg)
+{
+	struct padevent e;
+
+	if (backend == INPUT_EVDEV) {
+		while (evdev_read() >= 0);
+	} else {
+		while (joystick_read() >= 0);
+	}
+
+	/* Pad disconnected */
+	e.time = clock_nsec();
+	e.type = PADEVENT_DISCONNECT;
+	e.button = 0;
+	e.axis = 0;
+	e.value = 0;
+	ring_push(ring, &e);
+	ring_signal(ring);
+
+	return NULL;
+}
+
+/* Start the input thread, which feeds pad events into r. */
+int input_start(ring_t *r, const int *map)
+{
+	ring = r;
+	joymap = map;
+
+	if (pthread_create(&thread, NULL, input_thread, NULL) != 0)
+		return -1;
+	return 0;
+}
+
+/* Stop reading. Only valid after the thread has sent PADEVENT_DISCONNECT. */
+void input_close()
+{
+	pthread_join(thread, NULL);
+	if (fd >= 0)
+		close(fd);
+	fd = -1;
+}
@@ -19,10 +19,216 @@
  */
 
 #include "keyboard.h"
+#include "complete.h"
+#include "gesture.h"
 #include "keygtk.h"
+#include "layout.h"
+#include "mode.h"
+#include "output.h"
+#include "repeat.h"
+#include "snippet.h"
 
-Display *display;
-int shift = 0; // State of the shift toggle: nonzero if active.
+#include <string.h>
+
+/* Slots in the keysym to keycode table. Must be a power of two. */
+#define KEYTABLE_SIZE 2048
+
+/* Unused keycodes that may be borrowed for keysyms missing from the keymap. */
+#define KEYBOARD_MAX_SPARES 4
+
+/* Modifiers that must be held to reach a keysym on its keycode. */
+#define KEYMOD_SHIFT  0x1
+#define KEYMOD_LEVEL3 0x2
+
+struct keyentry
+{
+	KeySym sym;         /* NoSymbol if the slot is free. */
+	KeyCode code;
+	unsigned char mods; /* KEYMOD bits. */
+};
+
+static Display *display;
+static const layout_t *layout; // Active keyboard layout.
+
+/*
+ * Sticky modifiers, as KEYBOARD_MOD bits: a latched modifier is held
+ *  around the next key only, and a locked one around every key.
+ */
+static unsigned latched = 0, locked = 0;
+
+/* Text typed on the user's behalf, such as a snippet, goes without them. */
+static int suspended = 0;
+
+/* Typing is lent to mouse mode, and the chart is not up until it is used. */
+static int lending = 0;
+static const KeySym modifier_keys[KEYBOARD_MODS] = {
+	XK_Shift_L, XK_Control_L, XK_Alt_L, XK_Super_L
+};
+
+/*
+ * Open-addressed hash from keysym to the keycode that produces it.
+ * It is built from the server's keymap on first use, and thrown away
+ *  only when the server announces a new keymap with MappingNotify.
+ */
+static struct keyentry keytable[KEYTABLE_SIZE];
+static int keytable_valid = 0;
+static KeyCode shift_code, level3_code;
+
+/* Borrowed keycodes, rebound least-recently-used first. */
+static struct
+{
+	KeyCode code;
+	KeySym sym;
+	unsigned long used;
+} spares[KEYBOARD_MAX_SPARES];
+static int nspares = 0;
+static unsigned long spare_clock = 0;
+
+static inline unsigned keytable_hash(KeySym sym)
+{
+	return ((unsigned)sym * 2654435761u) & (KEYTABLE_SIZE - 1);
+}
+
+static struct keyentry *keytable_find(KeySym sym)
+{
+	unsigned i = keytable_hash(sym);
+
+	while (keytable[i].sym != NoSymbol) {
+		if (keytable[i].sym == sym)
+			return &keytable[i];
+		i = (i + 1) & (KEYTABLE_SIZE - 1);
+	}
+	return NULL;
+}
+
+/* Records sym, unless an easier way to type it is already known. */
+static void keytable_insert(KeySym sym, KeyCode code, unsigned char mods)
+{
+	unsigned i = keytable_hash(sym);
+
+	while (keytable[i].sym != NoSymbol) {
+		if (keytable[i].sym == sym)
+			return;
+		i = (i + 1) & (KEYTABLE_SIZE - 1);
+	}
+
+	keytable[i].sym = sym;
+	keytable[i].code = code;
+	keytable[i].mods = mods;
+}
+
+static int keyboard_is_spare(KeyCode code)
+{
+	for (int i = 0; i < nspares; i++)
+		if (spares[i].code == code)
+			return 1;
+	return 0;
+}
+
+/*
+ * Rebuild the table from the server's keymap.
+ * Group 1 of the core keymap has the plain and shifted keysyms in
+ *  columns 0 and 1, and the third and fourth levels in columns 4 and 5.
+ */
+static void keytable_build()
+{
+	static const int columns[] = { 0, 1, 4, 5 };
+	static const unsigned char mods[] = {
+		0, KEYMOD_SHIFT, KEYMOD_LEVEL3, KEYMOD_SHIFT | KEYMOD_LEVEL3
+	};
+	int min, max, per;
+
+	XDisplayKeycodes(display, &min, &max);
+	KeySym *syms = XGetKeyboardMapping(display, min, max - min + 1, &per);
+	if (syms == NULL)
+		return;
+
+	memset(keytable, 0x0, sizeof(keytable));
+
+	/* Borrowed keycodes stay ours only while nobody else has rebound them. */
+	for (int i = 0; i < nspares; i++) {
+		KeySym cur = syms[(spares[i].code - min) * per];
+		if (cur != NoSymbol && cur != spares[i].sym)
+			spares[i--] = spares[--nspares];
+	}
+
+	/* Lower levels are inserted first, so they win. */
+	for (int c = 0; c < 4; c++) {
+		if (columns[c] >= per)
+			continue;
+
+		for (int code = min; code <= max; code++) {
+			KeySym *row = &syms[(code - min) * per];
+			KeySym sym = row[columns[c]];
+
+			if (keyboard_is_spare(code))
+				continue;
+
+			/* A lone lowercase keysym implies its uppercase on Shift. */
+			if (c == 1 && sym == NoSymbol && row[0] != NoSymbol) {
+				KeySym lower, upper;
+				XConvertCase(row[0], &lower, &upper);
+				if (upper != lower)
+					sym = upper;
+			}
+
+			if (sym != NoSymbol)
+				keytable_insert(sym, code, mods[c]);
+		}
+	}
+
+	/* Collect keycodes with nothing bound to them. */
+	for (int code = max; code >= min && nspares < KEYBOARD_MAX_SPARES; code--) {
+		int empty = 1;
+		for (int c = 0; c < per; c++)
+			if (syms[(code - min) * per + c] != NoSymbol)
+				empty = 0;
+
+		if (empty && !keyboard_is_spare(code)) {
+			spares[nspares].code = code;
+			spares[nspares].sym = NoSymbol;
+			spares[nspares].used = 0;
+			nspares++;
+		}
+	}
+
+	XFree(syms);
+
+	struct keyentry *k;
+	shift_code = (k = keytable_find(XK_Shift_L)) ? k->code : 0;
+	if ((k = keytable_find(XK_ISO_Level3_Shift)) || (k = keytable_find(XK_Mode_switch)))
+		level3_code = k->code;
+	else
+		level3_code = 0;
+
+	keytable_valid = 1;
+}
+
+/*
+ * Find the keycode for a keysym the keymap lacks, binding one of the
+ *  borrowed keycodes to it if needed. Returns 0 if none are available.
+ */
+static KeyCode keyboard_spare_code(KeySym sym)
+{
+	int lru = -1;
+
+	for (int i = 0; i < nspares; i++) {
+		if (spares[i].sym == sym) {
+			spares[i].used = ++spare_clock;
+			return spares[i].code;
+		}
+		if (lru < 0 || spares[i].used < spares[lru].used)
+			lru = i;
+	}
+
+	if (lru < 0)
+		return 0;
+
+	spares[lru].sym = sym;
+	spares[lru].used = ++spare_clock;
+	output_remap(spares[lru].code, sym);
+	return spares[lru].code;
+}
 
 /* Keyboard initialization. */
 int keyboard_init(Display *d)
@@ -30,57 +236,295 @@ int keyboard_init(Display *d)
 	if (d == NULL) return -1;
 
 	display = d;
+	keytable_build();
 	return keygtk_init(d);
 }
 
-int keyboard_begin()
+/*
+ * Switch to a different keyboard layout.
+ * stock is nonzero if l is the built-in layout, which has pictures.
+ */
+void keyboard_set_layout(const layout_t *l, int stock)
+{
+	layout = l;
+	keygtk_use_layout(l, stock);
+}
+
+/* The server has a new keymap: rebuild the table before the next key. */
+void keyboard_mapping_changed()
+{
+	keytable_valid = 0;
+}
+
+/* Types key, and keeps typing it while the gesture's buttons are held. */
+static void keyboard_gesture_key(int key)
+{
+	keyboard_press(key);
+	if (repeat_key(key))
+		repeat_start(gesture_acting(), keyboard_gesture_key, key);
+}
+
+/*
+ * Release every sticky modifier. They are only shown under the chart,
+ *  so none may outlast it into mouse or steno mode, which also type
+ *  through keyboard_press().
+ */
+static void keyboard_clear_modifiers()
+{
+	latched = locked = 0;
+	keygtk_set_modifiers(latched, locked);
+}
+
+/*
+ * Steps a modifier from off to latched, from latched to locked,
+ *  and from locked back to off.
+ */
+static void keyboard_gesture_modifier(int mod)
+{
+	if (locked & mod) {
+		locked &= ~mod;
+	} else if (latched & mod) {
+		latched &= ~mod;
+		locked |= mod;
+	} else {
+		latched |= mod;
+	}
+	keygtk_set_modifiers(latched, locked);
+}
+
+/*
+ * Type the rest of a completion candidate, and a space after it.
+ * Without one, the arrow is stepped on as usual.
+ */
+static void keyboard_gesture_complete(int choice)
+{
+	char rest[COMPLETE_MAX_WORD + 1];
+	const char *suffix = complete_suffix(choice);
+
+	if (suffix == NULL) {
+		gesture_pass();
+		return;
+	}
+
+	/* Typing changes the candidates, and with them the suffix. */
+	strcpy(rest, suffix);
+	complete_accept(choice);
+	for (const char *c = rest; *c; c++)
+		keyboard_press((unsigned char)*c);
+	keyboard_press(XK_space);
+}
+
+/*
+ * Double-tap an arrow to press the matching arrow key, and a diagonal
+ *  to latch or lock Shift, Ctrl, Alt or Super.
+ * Tap Back, then step on left, up or right to finish the word with the
+ *  first, second or third candidate; no pair of arrows can do that.
+ * Tap Start on its own to switch to mouse mode.
+ */
+static const struct gesture keyboard_gestures[] = {
+	{ GESTURE_DOUBLETAP, BUTTON_LEFT,  0, keyboard_gesture_key, XK_Left },
+	{ GESTURE_DOUBLETAP, BUTTON_UP,    0, keyboard_gesture_key, XK_Up },
+	{ GESTURE_DOUBLETAP, BUTTON_RIGHT, 0, keyboard_gesture_key, XK_Right },
+	{ GESTURE_DOUBLETAP, BUTTON_DOWN,  0, keyboard_gesture_key, XK_Down },
+	{ GESTURE_DOUBLETAP, BUTTON_UPLEFT,    0, keyboard_gesture_modifier, KEYBOARD_MOD_SHIFT },
+	{ GESTURE_DOUBLETAP, BUTTON_UPRIGHT,   0, keyboard_gesture_modifier, KEYBOARD_MOD_CTRL },
+	{ GESTURE_DOUBLETAP, BUTTON_DOWNLEFT,  0, keyboard_gesture_modifier, KEYBOARD_MOD_ALT },
+	{ GESTURE_DOUBLETAP, BUTTON_DOWNRIGHT, 0, keyboard_gesture_modifier, KEYBOARD_MOD_SUPER },
+	{ GESTURE_SEQUENCE, BUTTON_BACK, BUTTON_LEFT,  keyboard_gesture_complete, 0 },
+	{ GESTURE_SEQUENCE, BUTTON_BACK, BUTTON_UP,    keyboard_gesture_complete, 1 },
+	{ GESTURE_SEQUENCE, BUTTON_BACK, BUTTON_RIGHT, keyboard_gesture_complete, 2 },
+	{ GESTURE_TAP,       BUTTON_START, 0, mode_toggle, 0 },
+};
+
+/* Begin keyboard mode, showing the chart. */
+void keyboard_begin()
 {
-	shift = 0;
-	keygtk_set_layout(0x0);
+	lending = 0;
+	keyboard_clear_modifiers();
+	complete_reset();
+	keygtk_set_completions(NULL, 0);
+	gesture_use(keyboard_gestures,
+	            sizeof(keyboard_gestures) / sizeof(keyboard_gestures[0]),
+	            keyboard_event);
+	mode_use_hybrid();
+	keygtk_set_layout(0x0, 0);
 	keygtk_window_show();
-	return 0;
 }
 
-int keyboard_end()
+/* End keyboard mode. */
+void keyboard_end()
 {
+	lending = 0;
+	keyboard_clear_modifiers();
 	keygtk_window_hide();
-	return 0;
 }
 
-/* Internal wrapper for XTestFakeKeyEvent. */
-static inline int keyboard_keyevent(unsigned key, int pushed)
+/*
+ * Lend typing to mouse mode while its hybrid button is held.
+ * The chart is only shown once an arrow is pressed, so a tap of the
+ *  hybrid button that switches modes does not flash it up and down.
+ */
+void keyboard_lend()
 {
-	return XTestFakeKeyEvent(display, XKeysymToKeycode(display, key),
-	                         pushed, CurrentTime);
+	gesture_borrow(keyboard_gestures,
+	               sizeof(keyboard_gestures) / sizeof(keyboard_gestures[0]),
+	               keyboard_event);
+	complete_reset();
+	keygtk_set_completions(NULL, 0);
+	keygtk_set_layout(0x0, 0);
+	lending = 1;
 }
 
-/* Send a key press event to the current window. */
+void keyboard_reclaim()
+{
+	lending = 0;
+	keyboard_clear_modifiers();
+	keygtk_window_hide();
+}
+
+/*
+ * Internal wrapper for injecting a key event.
+ * Any modifiers the keysym needs are held around it.
+ */
+static void keyboard_keyevent(KeySym key, int pushed)
+{
+	unsigned char mods = 0;
+	KeyCode code;
+
+	if (!keytable_valid)
+		keytable_build();
+
+	struct keyentry *k = keytable_find(key);
+	if (k != NULL) {
+		code = k->code;
+		mods = k->mods;
+	} else if (!(code = keyboard_spare_code(key))) {
+		return;
+	}
+
+	if (pushed) {
+		if ((mods & KEYMOD_SHIFT) && shift_code)
+			output_key(shift_code, True);
+		if ((mods & KEYMOD_LEVEL3) && level3_code)
+			output_key(level3_code, True);
+		output_key(code, True);
+	} else {
+		output_key(code, False);
+		if ((mods & KEYMOD_LEVEL3) && level3_code)
+			output_key(level3_code, False);
+		if ((mods & KEYMOD_SHIFT) && shift_code)
+			output_key(shift_code, False);
+	}
+}
+
+/*
+ * Send a key press event to the current window,
+ *  holding the sticky modifiers around it. Latched ones are used up.
+ */
 void keyboard_press(unsigned key)
 {
-	if (shift)
-		keyboard_keyevent(XK_Shift_R, True);
+	unsigned mods = suspended ? 0 : latched | locked;
+
+	for (int i = 0; i < KEYBOARD_MODS; i++)
+		if (mods & (1 << i))
+			keyboard_keyevent(modifier_keys[i], True);
 
 	keyboard_keyevent(key, True);  // press key
 	keyboard_keyevent(key, False); // release key
 
-	if (shift)
-		keyboard_keyevent(XK_Shift_R, False);
+	for (int i = KEYBOARD_MODS - 1; i >= 0; i--)
+		if (mods & (1 << i))
+			keyboard_keyevent(modifier_keys[i], False);
+
+	if (latched && !suspended) {
+		latched = 0;
+		keygtk_set_modifiers(latched, locked);
+	}
+
+	/* Follow the word being typed, and offer ways to finish it. */
+	const char *candidates[COMPLETE_CHOICES];
+	complete_key(key, mods & ~KEYBOARD_MOD_SHIFT);
+	snippet_key(key, mods & ~KEYBOARD_MOD_SHIFT);
+	keygtk_set_completions(candidates,
+	                       complete_candidates(candidates, COMPLETE_CHOICES));
+}
+
+/*
+ * Type keys without the sticky modifiers until keyboard_resume_modifiers(),
+ *  which leaves them as they were. Calls may nest.
+ */
+void keyboard_suspend_modifiers()
+{
+	suspended++;
+}
+
+void keyboard_resume_modifiers()
+{
+	if (suspended > 0)
+		suspended--;
+}
+
+/*
+ * Type a string of UTF-8 text, as one batch of events.
+ * Returns the number of characters typed.
+ */
+int keyboard_type(const char *text)
+{
+	const unsigned char *t = (const unsigned char *)text;
+	int n = 0;
+
+	output_batch_begin();
+	while (*t) {
+		unsigned c = *t++;
+		if ((c & 0xc0) == 0x80)
+			continue;
+		int more = (c >= 0xf0) ? 3 : (c >= 0xe0) ? 2 : (c >= 0xc0) ? 1 : 0;
+
+		if (more)
+			c &= 0x3f >> more;
+		for (; more && (*t & 0xc0) == 0x80; more--)
+			c = (c << 6) | (*t++ & 0x3f);
+		if (more)
+			continue;
+
+		/* Latin-1 keysyms are their code points; the rest are offset. */
+		if (c == '\n')
+			keyboard_press(XK_Return);
+		else if (c == '\t')
+			keyboard_press(XK_Tab);
+		else if (c >= 0x20 && c < 0x100 && c != 0x7f)
+			keyboard_press(c);
+		else if (c >= 0x100)
+			keyboard_press(0x01000000 | c);
+		else
+			continue;
+		n++;
+	}
+	output_batch_end();
+
+	return n;
 }
 
 /*
  * The keyboard is modal: pressing the first button sets the mode,
  *  modifying keyboard layout; the second button then selects the letter
  *  from those available within that mode.
+ * Start and Back select the layer, and may be held before or during
+ *  either step.
  */
 void keyboard_event(buttonstate_t buttons, button_t changed)
 {
-	static int layout = 0x0;
+	static button_t first = 0x0;
+	int layer = layout_layer(buttons);
 
 	if (!changed) return;
 
-	if (!buttons) {
-		layout = 0x0;
-		keygtk_set_layout(layout);
+	if (lending && (buttons & changed & BUTTON_ARROWS))
+		keygtk_window_show();
+
+	if (!(buttons & BUTTON_ARROWS)) {
+		first = 0x0;
+		keygtk_set_layout(first, layer);
 		return;
 	}
 
@@ -89,107 +533,26 @@ void keyboard_event(buttonstate_t buttons, button_t changed)
 		return;
 	}
 
-	/* If only one button is pressed, set the layout. */
-	if (buttons && (buttons & (buttons - 1)) == 0) {
-		if (buttons != BUTTON_START && buttons != BUTTON_BACK) {
-			layout = buttons;
-			keygtk_set_layout(layout);
-		}
+	/* Switching layers mid-step only changes what is shown. */
+	if (!(changed & BUTTON_ARROWS)) {
+		keygtk_set_layout(first, layer);
 		return;
 	}
 
-	// TODO: Handle double-tapping for arrow key pressing.
-	
-	/* Otherwise, type the key that was just selected. */
-	int k = 0;
-	switch (layout) {
-		case BUTTON_LEFT: {
-			switch (changed) {
-				case BUTTON_UPLEFT:    k = XK_a; break;
-				case BUTTON_UP:        k = XK_b; break;
-				case BUTTON_UPRIGHT:   k = XK_c; break;
-				case BUTTON_RIGHT:     k = XK_d; break;
-				case BUTTON_DOWNRIGHT: k = XK_e; break;
-				case BUTTON_DOWN:      k = XK_f; break;
-				case BUTTON_DOWNLEFT:  k = XK_g; break;
-				default: return;
-			}
-			break;
-		}
-
-		case BUTTON_UP: {
-			switch (changed) {
-				case BUTTON_UPRIGHT:   k = XK_h; break;
-				case BUTTON_RIGHT:     k = XK_i; break;
-				case BUTTON_DOWNRIGHT: k = XK_j; break;
-				case BUTTON_DOWN:      k = XK_k; break;
-				case BUTTON_DOWNLEFT:  k = XK_l; break;
-				case BUTTON_LEFT:      k = XK_m; break;
-				case BUTTON_UPLEFT:    k = XK_n; break;
-				default: return;
-			}
-			break;
-		}
-
-		case BUTTON_RIGHT: {
-			switch (changed) {
-				case BUTTON_DOWNRIGHT: k = XK_o; break;
-				case BUTTON_DOWN:      k = XK_p; break;
-				case BUTTON_DOWNLEFT:  k = XK_q; break;
-				case BUTTON_LEFT:      k = XK_r; break;
-				case BUTTON_UPLEFT:    k = XK_s; break;
-				case BUTTON_UP:        k = XK_t; break;
-				case BUTTON_UPRIGHT:   k = XK_u; break;
-				default: return;
-			}
-			break;
-		}
-
-		case BUTTON_DOWN: {
-			switch (changed) {
-				case BUTTON_DOWNLEFT:  k = XK_v; break;
-				case BUTTON_LEFT:      k = XK_w; break;
-				case BUTTON_UPLEFT:    k = XK_x; break;
-				case BUTTON_UP:        k = XK_y; break;
-				case BUTTON_UPRIGHT:   k = XK_z; break;
-				case BUTTON_RIGHT:     k = XK_BackSpace; break;
-				case BUTTON_DOWNRIGHT: k = XK_slash; break;
-				default: return;
-			}
-			break;
-		}
-
-		case BUTTON_UPLEFT: {
-			switch (changed) {
-				case BUTTON_UP:        k = XK_0; break;
-				case BUTTON_UPRIGHT:   k = XK_1; break;
-				case BUTTON_RIGHT:     k = XK_2; break;
-				case BUTTON_DOWNRIGHT: k = XK_3; break;
-				case BUTTON_DOWN:      k = XK_4; break;
-				case BUTTON_DOWNLEFT:  k = XK_5; break;
-				case BUTTON_LEFT:      k = XK_6; break;
-				default: return;
-			}
-			break;
-		}
-
-		case BUTTON_UPRIGHT: {
-			switch (changed) {
-				case BUTTON_RIGHT:     k = XK_7; break;
-				case BUTTON_DOWNRIGHT: k = XK_8; break;
-				case BUTTON_DOWN:      k = XK_9; break;
-				case BUTTON_DOWNLEFT:  k = XK_apostrophe; break;
-				case BUTTON_LEFT:      k = XK_question; break;
-				case BUTTON_UPLEFT:    k = XK_comma; break;
-				case BUTTON_UP:        k = XK_period; break;
-				default: return;
-			}
-			break;
-		}
-
-		default: return;
+	/* If only one arrow is pressed, set the layout. */
+	if (((buttons & BUTTON_ARROWS) & ((buttons & BUTTON_ARROWS) - 1)) == 0) {
+		first = buttons & BUTTON_ARROWS;
+		keygtk_set_layout(first, layer);
+		return;
 	}
 
+	/* Otherwise, type the key that was just selected. */
+	KeySym k = layout->keys[layer][button_index(first)][button_index(changed)];
+	if (k == NoSymbol)
+		return;
+
+	/* Keep typing it for as long as the second arrow stays down. */
 	keyboard_press(k);
+	if (repeat_key(k))
+		repeat_start(changed, keyboard_gesture_key, k);
 }
-
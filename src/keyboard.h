@@ -19,17 +19,34 @@
  */
 
 #ifndef __mousepad_keyboard_h__
+#define __mousepad_keyboard_h__
 
 #include "mousepad.h"
+#include "layout.h"
 
 #include <X11/X.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
-#include <X11/extensions/XTest.h>
+
+/* Modifiers that gestures may latch or lock, as bits. */
+#define KEYBOARD_MOD_SHIFT 0x1
+#define KEYBOARD_MOD_CTRL  0x2
+#define KEYBOARD_MOD_ALT   0x4
+#define KEYBOARD_MOD_SUPER 0x8
+#define KEYBOARD_MODS      4
 
 int keyboard_init(Display *d);
+void keyboard_set_layout(const layout_t *l, int stock);
+void keyboard_begin();
+void keyboard_end();
+void keyboard_lend();
+void keyboard_reclaim();
+void keyboard_mapping_changed();
 void keyboard_press(unsigned key);
-void keyboard_event();
+void keyboard_suspend_modifiers();
+void keyboard_resume_modifiers();
+int keyboard_type(const char *text);
+void keyboard_event(buttonstate_t buttons, button_t changed);
 
 #endif /* __mousepad_keyboard_h__ */
 
@@ -18,7 +18,9 @@
  * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include "mousepad.h"
+#include "keygtk.h"
+
+#include <stdio.h>
 
 #include <gtk/gtk.h>
 
@@ -27,11 +29,44 @@
 
 #define DISTANCE_FROM_CORNER 20
 
-Display *display;
+static Display *display;
 GtkWindow *window;
 GtkImage *image;
 int window_shown = 0;
 
+/*
+ * Layouts without pictures are drawn as a grid of labels instead,
+ *  one per arrow, laid out like the pad.
+ */
+static const layout_t *layout;
+static int layout_stock;
+static GtkWidget *grid;
+static GtkLabel *labels[NBUTTONS];
+static GtkLabel *center;
+
+/* Sticky modifiers, named in a label under the chart while any are on. */
+static GtkLabel *status;
+static unsigned modifiers;
+static int shown_first, shown_layer;
+
+static const char *modifier_names[KEYBOARD_MODS] = { "Shift", "Ctrl", "Alt", "Super" };
+
+/* Completion candidates, each after the arrow that picks it after Back. */
+static GtkLabel *completions;
+static const char *completion_jumps[] = {
+	"\u2190", "\u2191", "\u2192"
+};
+
+static const struct
+{
+	button_t button;
+	int col, row;
+} cells[] = {
+	{ BUTTON_UPLEFT,   0, 0 }, { BUTTON_UP,   1, 0 }, { BUTTON_UPRIGHT,   2, 0 },
+	{ BUTTON_LEFT,     0, 1 },                        { BUTTON_RIGHT,     2, 1 },
+	{ BUTTON_DOWNLEFT, 0, 2 }, { BUTTON_DOWN, 1, 2 }, { BUTTON_DOWNRIGHT, 2, 2 },
+};
+
 struct
 {
 	GdkPixbuf *left, *left_shift,
@@ -101,12 +136,38 @@ int keygtk_init(Display *d)
 	
 	/* Create image widget. */
 	image = (GtkImage *)gtk_image_new_from_pixbuf(pixbufs.none);
-	
-	gtk_container_add(GTK_CONTAINER(window), (GtkWidget *)image);
+
+	/* Create label grid, which takes the image's place when shown. */
+	grid = gtk_table_new(3, 3, TRUE);
+	gtk_widget_set_size_request(grid, window_width, window_width);
+	for (int i = 0; i < sizeof(cells) / sizeof(cells[0]); i++) {
+		GtkWidget *label = gtk_label_new("");
+		labels[button_index(cells[i].button)] = (GtkLabel *)label;
+		gtk_table_attach_defaults(GTK_TABLE(grid), label,
+		                          cells[i].col, cells[i].col + 1,
+		                          cells[i].row, cells[i].row + 1);
+		gtk_widget_show(label);
+	}
+	center = (GtkLabel *)gtk_label_new("");
+	gtk_table_attach_defaults(GTK_TABLE(grid), (GtkWidget *)center, 1, 2, 1, 2);
+	gtk_widget_show((GtkWidget *)center);
+
+	GtkWidget *box = gtk_vbox_new(FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(box), (GtkWidget *)image, TRUE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(box), grid, TRUE, TRUE, 0);
+	status = (GtkLabel *)gtk_label_new("");
+	gtk_box_pack_start(GTK_BOX(box), (GtkWidget *)status, FALSE, FALSE, 0);
+	completions = (GtkLabel *)gtk_label_new("");
+	gtk_box_pack_start(GTK_BOX(box), (GtkWidget *)completions, FALSE, FALSE, 0);
+	gtk_container_add(GTK_CONTAINER(window), box);
+	gtk_widget_show(box);
 	gtk_widget_show((GtkWidget *)image);
 
 	gtk_image_set_from_pixbuf(image, pixbufs.none); // TODO: Necessary?
 
+	/* Create the X window now, so that showing it later only maps it. */
+	gtk_widget_realize((GtkWidget *)window);
+
 	return 0;
 }
 
@@ -115,9 +176,6 @@ void keygtk_window_show()
 	if (window_shown) return;
 	gtk_widget_show((GtkWidget *)window);
 	window_shown = 1;
-
-	while (gtk_events_pending())
-		gtk_main_iteration();
 }
 
 void keygtk_window_hide()
@@ -125,40 +183,204 @@ void keygtk_window_hide()
 	if (!window_shown) return;
 	gtk_widget_hide((GtkWidget *)window);
 	window_shown = 0;
+}
+
+/*
+ * Choose the layout to display.
+ * The built-in layout (stock) is shown with the pictures in img/.
+ */
+void keygtk_use_layout(const layout_t *l, int stock)
+{
+	layout = l;
+	layout_stock = stock;
+}
 
-	while (gtk_events_pending())
-		gtk_main_iteration();
+/* Writes the UTF-8 encoding of a code point into buf. */
+static void keygtk_utf8(unsigned c, char *buf)
+{
+	if (c < 0x80) {
+		buf[0] = c;
+		buf[1] = '\0';
+	} else if (c < 0x800) {
+		buf[0] = 0xc0 | (c >> 6);
+		buf[1] = 0x80 | (c & 0x3f);
+		buf[2] = '\0';
+	} else if (c < 0x10000) {
+		buf[0] = 0xe0 | (c >> 12);
+		buf[1] = 0x80 | ((c >> 6) & 0x3f);
+		buf[2] = 0x80 | (c & 0x3f);
+		buf[3] = '\0';
+	} else {
+		buf[0] = 0xf0 | (c >> 18);
+		buf[1] = 0x80 | ((c >> 12) & 0x3f);
+		buf[2] = 0x80 | ((c >> 6) & 0x3f);
+		buf[3] = 0x80 | (c & 0x3f);
+		buf[4] = '\0';
+	}
+}
+
+/* Short text for a keysym: the character it types, or else its name. */
+static void keygtk_keysym_text(KeySym sym, char *buf, int len)
+{
+	const char *name;
+	KeySym lower, upper;
+
+	/* Show the capital that Shift will type. */
+	if (modifiers & KEYBOARD_MOD_SHIFT) {
+		XConvertCase(sym, &lower, &upper);
+		sym = upper;
+	}
+
+	if ((sym > 0x20 && sym < 0x7f) || (sym >= 0xa0 && sym <= 0xff))
+		keygtk_utf8(sym, buf);
+	else if ((sym & 0xff000000) == 0x01000000)
+		keygtk_utf8(sym & 0x00ffffff, buf);
+	else if ((name = XKeysymToString(sym)) != NULL)
+		snprintf(buf, len, "%s", name);
+	else
+		buf[0] = '\0';
+}
+
+/*
+ * Fill the label grid for the given first step.
+ * With no first step, each arrow shows the range of keys it leads to.
+ */
+static void keygtk_fill_grid(int first, int layer)
+{
+	char text[64], from[32], to[32];
+
+	for (int i = 0; i < sizeof(cells) / sizeof(cells[0]); i++) {
+		int b = button_index(cells[i].button);
+		text[0] = '\0';
+
+		if (first) {
+			keygtk_keysym_text(layout->keys[layer][button_index(first)][b],
+			                   text, sizeof(text));
+		} else {
+			KeySym lo = NoSymbol, hi = NoSymbol;
+			for (int j = 0; j < NBUTTONS; j++) {
+				KeySym sym = layout->keys[layer][b][j];
+				if (sym == NoSymbol)
+					continue;
+				if (lo == NoSymbol)
+					lo = sym;
+				hi = sym;
+			}
+			if (lo != NoSymbol) {
+				keygtk_keysym_text(lo, from, sizeof(from));
+				keygtk_keysym_text(hi, to, sizeof(to));
+				snprintf(text, sizeof(text), "%s - %s", from, to);
+			}
+		}
+
+		gtk_label_set_text(labels[b], text);
+	}
+
+	if (layer)
+		snprintf(text, sizeof(text), "layer %d", layer);
+	else
+		text[0] = '\0';
+	gtk_label_set_text(center, text);
 }
 
 /*
  * Set the pad button -> key binding into a particular layout mode.
- * layout is one of the BUTTON defines, or 0x0 to clear the layout.
+ * first is one of the BUTTON defines, or 0x0 to clear the layout.
+ * layer is the layer of the layout that is in use.
  */
-int keygtk_set_layout(int layout)
+int keygtk_set_layout(int first, int layer)
 {
 	GdkPixbuf *pixbuf = NULL;
+	int shift = (modifiers & KEYBOARD_MOD_SHIFT) != 0;
 
-	// TODO: Handle the Shift key.
-	switch (layout) {
-		case 0x0:              pixbuf = pixbufs.none;      break;
-		case BUTTON_LEFT:      pixbuf = pixbufs.left;      break;
-		case BUTTON_UPLEFT:    pixbuf = pixbufs.upleft;    break;
-		case BUTTON_UP:        pixbuf = pixbufs.up;        break;
-		case BUTTON_UPRIGHT:   pixbuf = pixbufs.upright;   break;
-		case BUTTON_RIGHT:     pixbuf = pixbufs.right;     break;
-		case BUTTON_DOWNRIGHT: pixbuf = pixbufs.none;      break;
-		case BUTTON_DOWN:      pixbuf = pixbufs.down;      break;
-		case BUTTON_DOWNLEFT:  pixbuf = pixbufs.none;      break;
-		default:
-			return -1;
-	}
+	shown_first = first;
+	shown_layer = layer;
 
-	gtk_image_clear(image); //TODO: Necessary?
-	gtk_image_set_from_pixbuf(image, pixbuf);
+	if (layout_stock && layer == 0) {
+		switch (first) {
+			case 0x0:              pixbuf = pixbufs.none;      break;
+			case BUTTON_LEFT:
+				pixbuf = shift ? pixbufs.left_shift : pixbufs.left;
+				break;
+			case BUTTON_UPLEFT:
+				pixbuf = shift ? pixbufs.upleft_shift : pixbufs.upleft;
+				break;
+			case BUTTON_UP:
+				pixbuf = shift ? pixbufs.up_shift : pixbufs.up;
+				break;
+			case BUTTON_UPRIGHT:
+				pixbuf = shift ? pixbufs.upright_shift : pixbufs.upright;
+				break;
+			case BUTTON_RIGHT:
+				pixbuf = shift ? pixbufs.right_shift : pixbufs.right;
+				break;
+			case BUTTON_DOWN:
+				pixbuf = shift ? pixbufs.down_shift : pixbufs.down;
+				break;
+			case BUTTON_DOWNRIGHT: /* fall through */
+			case BUTTON_DOWNLEFT:  break;
+			default:
+				return -1;
+		}
+	}
 
-	while (gtk_events_pending())
-		gtk_main_iteration();
+	if (pixbuf) {
+		gtk_widget_hide(grid);
+		gtk_image_clear(image); //TODO: Necessary?
+		gtk_image_set_from_pixbuf(image, pixbuf);
+		gtk_widget_show((GtkWidget *)image);
+	} else if (layout) {
+		gtk_widget_hide((GtkWidget *)image);
+		keygtk_fill_grid(first, layer);
+		gtk_widget_show(grid);
+	}
 
 	return 0;
 }
 
+/*
+ * Show which modifiers are latched for the next key, and which are
+ *  locked, given as KEYBOARD_MOD bits. Locked ones are bracketed.
+ */
+void keygtk_set_modifiers(unsigned latched, unsigned locked)
+{
+	char text[64];
+	int len = 0;
+
+	modifiers = latched | locked;
+	text[0] = '\0';
+	for (int i = 0; i < KEYBOARD_MODS; i++) {
+		const char *fmt = (locked & (1 << i)) ? "%s[%s]" : "%s%s";
+		if (modifiers & (1 << i))
+			len += snprintf(text + len, sizeof(text) - len, fmt,
+			                len ? " " : "", modifier_names[i]);
+	}
+
+	gtk_label_set_text(status, text);
+	if (modifiers)
+		gtk_widget_show((GtkWidget *)status);
+	else
+		gtk_widget_hide((GtkWidget *)status);
+
+	/* Capitals look different: redraw the chart. */
+	if (layout)
+		keygtk_set_layout(shown_first, shown_layer);
+}
+
+/* Show the candidates for finishing the word being typed, best first. */
+void keygtk_set_completions(const char **words, int n)
+{
+	char text[256];
+	int len = 0;
+
+	text[0] = '\0';
+	for (int i = 0; i < n && i < sizeof(completion_jumps) / sizeof(completion_jumps[0]); i++)
+		len += snprintf(text + len, sizeof(text) - len, "%s%s %s",
+		                i ? "   " : "", completion_jumps[i], words[i]);
+
+	gtk_label_set_text(completions, text);
+	if (n)
+		gtk_widget_show((GtkWidget *)completions);
+	else
+		gtk_widget_hide((GtkWidget *)completions);
+}
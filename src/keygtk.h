@@ -19,6 +19,10 @@
  */
 
 #ifndef __mousepad_keygtk_h__
+#define __mousepad_keygtk_h__
+
+#include "keyboard.h"
+#include "layout.h"
 
 #include <X11/X.h>
 #include <X11/Xlib.h>
@@ -26,7 +30,10 @@
 int keygtk_init(Display *d);
 void keygtk_window_show();
 void keygtk_window_hide();
-int keygtk_set_layout(int layout);
+void keygtk_use_layout(const layout_t *l, int stock);
+int keygtk_set_layout(int first, int layer);
+void keygtk_set_modifiers(unsigned latched, unsigned locked);
+void keygtk_set_completions(const char **words, int n);
 
 #endif /* __mousepad_keygtk_h__ */
 
@@ -0,0 +1,255 @@
+/*
+ * layout.c
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "layout.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <X11/Xlib.h>
+
+#define LAYOUT_LINE_LENGTH 256
+
+/*
+ * Layout files hold one binding per line:
+ *
+ *   layer 1
+ *   left upleft a
+ *   down right BackSpace
+ *
+ * naming the first arrow, the second arrow, and the keysym to type.
+ * Keysyms are X keysym names, or a single character standing for itself.
+ * Bindings apply to layer 0 until a "layer" line selects another layer.
+ * Everything after a '#' that starts a word is a comment.
+ */
+
+/* The layout drawn in img/, used when no layout file exists. */
+static const char *layout_builtin[] = {
+	"layer 0",
+	"left upleft a",    "left up b",          "left upright c",
+	"left right d",     "left downright e",   "left down f",
+	"left downleft g",
+
+	"up upright h",     "up right i",         "up downright j",
+	"up down k",        "up downleft l",      "up left m",
+	"up upleft n",
+
+	"right downright o", "right down p",      "right downleft q",
+	"right left r",      "right upleft s",    "right up t",
+	"right upright u",
+
+	"down downleft v",  "down left w",        "down upleft x",
+	"down up y",        "down upright z",     "down right BackSpace",
+	"down downright slash",
+
+	"upleft up 0",      "upleft upright 1",   "upleft right 2",
+	"upleft downright 3", "upleft down 4",    "upleft downleft 5",
+	"upleft left 6",
+
+	"upright right 7",  "upright downright 8", "upright down 9",
+	"upright downleft apostrophe", "upright left question",
+	"upright upleft comma", "upright up period",
+
+	"downright left space", "downright upleft Return", "downright up Tab",
+	"downright upright Escape", "downright right Delete",
+	"downright down Home", "downright downleft End",
+
+	"downleft up semicolon", "downleft upright colon",
+	"downleft right minus", "downleft downright equal",
+	"downleft down exclam", "downleft left at", "downleft upleft numbersign",
+	NULL
+};
+
+static const struct
+{
+	const char *name;
+	button_t button;
+} button_names[] = {
+	{ "left",      BUTTON_LEFT },
+	{ "upleft",    BUTTON_UPLEFT },
+	{ "up",        BUTTON_UP },
+	{ "upright",   BUTTON_UPRIGHT },
+	{ "right",     BUTTON_RIGHT },
+	{ "downright", BUTTON_DOWNRIGHT },
+	{ "down",      BUTTON_DOWN },
+	{ "downleft",  BUTTON_DOWNLEFT },
+	{ "start",     BUTTON_START },
+	{ "back",      BUTTON_BACK },
+};
+
+/* Returns the button with the given name, or 0 if there is none. */
+int layout_button(const char *name)
+{
+	for (int i = 0; i < NBUTTONS; i++)
+		if (!strcmp(name, button_names[i].name))
+			return button_names[i].button;
+	return 0;
+}
+
+/* Returns the name of a button, as used in layout and settings files. */
+const char *layout_button_name(button_t button)
+{
+	for (int i = 0; i < NBUTTONS; i++)
+		if (button_names[i].button == button)
+			return button_names[i].name;
+	return "none";
+}
+
+/* Returns the layer selected by the held Start and Back buttons. */
+int layout_layer(buttonstate_t buttons)
+{
+	return ((buttons & BUTTON_START) ? 1 : 0) |
+	       ((buttons & BUTTON_BACK)  ? 2 : 0);
+}
+
+/* Parses a keysym name, or a single printable character. */
+static KeySym layout_keysym(const char *name)
+{
+	if (name[0] > ' ' && name[0] < 0x7f && name[1] == '\0')
+		return (KeySym)name[0];
+	return XStringToKeysym(name);
+}
+
+/*
+ * Parse one line into l, tracking the current layer.
+ * Returns -1 on a malformed line.
+ */
+static int layout_parse(layout_t *l, int *layer, char *line)
+{
+	char *words[3];
+	int n = 0;
+
+	for (char *w = strtok(line, " \t\r\n"); w; w = strtok(NULL, " \t\r\n")) {
+		if (w[0] == '#')
+			break;
+		if (n == 3)
+			return -1;
+		words[n++] = w;
+	}
+
+	if (n == 0)
+		return 0;
+
+	if (n == 2 && !strcmp(words[0], "layer")) {
+		*layer = atoi(words[1]);
+		if (*layer < 0 || *layer >= LAYOUT_LAYERS)
+			return -1;
+		return 0;
+	}
+
+	if (n != 3)
+		return -1;
+
+	button_t first  = layout_button(words[0]);
+	button_t second = layout_button(words[1]);
+	KeySym sym = layout_keysym(words[2]);
+
+	if (!(first & BUTTON_ARROWS) || !(second & BUTTON_ARROWS) ||
+	    first == second || sym == NoSymbol)
+		return -1;
+
+	l->keys[*layer][button_index(first)][button_index(second)] = sym;
+	return 0;
+}
+
+/*
+ * Look for a layout file, first in ~/.LAYOUT_FILENAME,
+ *  then in /etc/LAYOUT_FILENAME.
+ * Returns NULL if neither file exists or if fopen() fails.
+ */
+FILE *layout_open()
+{
+	char *home = getenv("HOME");
+	if (home != NULL) {
+		FILE *f;
+		char *path = alloca(strlen(home) + strlen("/."LAYOUT_FILENAME) + 1);
+		strcpy(path, home);
+		strcat(path, "/."LAYOUT_FILENAME);
+
+		if ((f = fopen(path, "r")) != NULL)
+			return f;
+	}
+
+	return fopen("/etc/"LAYOUT_FILENAME, "r");
+}
+
+/* Close the layout file. */
+int layout_close(FILE *f)
+{
+	if (f == NULL)
+		return -1;
+	return fclose(f);
+}
+
+/*
+ * Read a layout file into l, replacing its contents.
+ * Returns -1 if the file is malformed, after reporting the bad line.
+ */
+int layout_read(FILE *f, layout_t *l)
+{
+	char line[LAYOUT_LINE_LENGTH];
+	int layer = 0;
+
+	memset(l, 0x0, sizeof(layout_t));
+
+	for (int lineno = 1; fgets(line, sizeof(line), f) != NULL; lineno++) {
+		if (layout_parse(l, &layer, line) < 0) {
+			fprintf(stderr, " Bad binding on line %d of the layout file.\n",
+			        lineno);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* Write l out as a layout file that layout_read() can load. */
+int layout_write(FILE *f, const layout_t *l)
+{
+	for (int layer = 0; layer < LAYOUT_LAYERS; layer++) {
+		fprintf(f, "layer %d\n", layer);
+		for (int a = 0; a < NBUTTONS; a++) {
+			for (int b = 0; b < NBUTTONS; b++) {
+				const char *name = XKeysymToString(l->keys[layer][a][b]);
+				if (name == NULL)
+					continue;
+				fprintf(f, "%s %s %s\n", layout_button_name(1 << a),
+				        layout_button_name(1 << b), name);
+			}
+		}
+	}
+
+	return ferror(f) ? -1 : 0;
+}
+
+/* Fill l with the built-in layout. */
+void layout_default(layout_t *l)
+{
+	char line[LAYOUT_LINE_LENGTH];
+	int layer = 0;
+
+	memset(l, 0x0, sizeof(layout_t));
+
+	for (int i = 0; layout_builtin[i] != NULL; i++) {
+		strcpy(line, layout_builtin[i]);
+		layout_parse(l, &layer, line);
+	}
+}
@@ -0,0 +1,58 @@
+/*
+ * layout.h
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __mousepad_layout_h__
+#define __mousepad_layout_h__
+
+#include "mousepad.h"
+
+#include <stdio.h>
+
+#include <X11/X.h>
+
+#define LAYOUT_FILENAME "mousepad.layout"
+
+/*
+ * Layer 0 is typed with only arrows held; layer 1 while Start is held,
+ *  layer 2 while Back is held, and layer 3 while both are.
+ */
+#define LAYOUT_LAYERS 4
+
+/*
+ * Keyboard layout, as a flat lookup table:
+ *  keys[layer][first arrow index][second arrow index] is the keysym typed
+ *  by holding the first arrow and stepping on the second,
+ *  or NoSymbol if that pair types nothing.
+ */
+typedef struct
+{
+	KeySym keys[LAYOUT_LAYERS][NBUTTONS][NBUTTONS];
+} layout_t;
+
+FILE *layout_open();
+int layout_read(FILE *f, layout_t *l);
+int layout_write(FILE *f, const layout_t *l);
+int layout_close(FILE *f);
+void layout_default(layout_t *l);
+int layout_layer(buttonstate_t buttons);
+int layout_button(const char *name);
+const char *layout_button_name(button_t button);
+
+#endif /* __mousepad_layout_h__ */
@@ -0,0 +1,304 @@
+/*
+ * magnet.c
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "magnet.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Targets the cursor is drawn to: the edges and middles of top-level
+ *  windows. The window list is read with XQueryTree once, then kept up
+ *  to date from the SubstructureNotify events on the root window.
+ *
+ * Lookups go through a uniform grid over the screen. Each window is
+ *  filed in the cells that its edges and middle reach, widened by the
+ *  magnet radius, so a lookup only reads the cell under the cursor.
+ *  The grid is rebuilt from the list after the list changes, which is
+ *  rare next to the rate of lookups.
+ */
+
+struct magnet_window
+{
+	Window id;
+	int x, y, width, height;
+	int mapped;
+};
+
+struct magnet_cell
+{
+	unsigned short n;
+	unsigned short windows[MAGNET_CELL_MAX];
+};
+
+static Display *display;
+static Window root;
+static int radius;
+
+static struct magnet_window windows[MAGNET_MAX_WINDOWS];
+static int nwindows = 0;
+
+static struct magnet_cell *cells;
+static int cols, rows;
+static int cells_valid = 0;
+
+static struct magnet_window *magnet_find(Window id)
+{
+	for (int i = 0; i < nwindows; i++)
+		if (windows[i].id == id)
+			return &windows[i];
+	return NULL;
+}
+
+static struct magnet_window *magnet_add(Window id)
+{
+	struct magnet_window *w = magnet_find(id);
+
+	if (w == NULL && nwindows < MAGNET_MAX_WINDOWS) {
+		w = &windows[nwindows++];
+		memset(w, 0x0, sizeof(struct magnet_window));
+		w->id = id;
+	}
+	return w;
+}
+
+static void magnet_remove(Window id)
+{
+	struct magnet_window *w = magnet_find(id);
+
+	if (w != NULL)
+		*w = windows[--nwindows];
+}
+
+/* File window i in every cell overlapping the rectangle. */
+static void magnet_file(int i, int x0, int y0, int x1, int y1)
+{
+	int c0 = x0 / MAGNET_CELL_SIZE, c1 = x1 / MAGNET_CELL_SIZE;
+	int r0 = y0 / MAGNET_CELL_SIZE, r1 = y1 / MAGNET_CELL_SIZE;
+
+	if (c0 < 0) c0 = 0;
+	if (r0 < 0) r0 = 0;
+	if (c1 >= cols) c1 = cols - 1;
+	if (r1 >= rows) r1 = rows - 1;
+
+	for (int r = r0; r <= r1; r++) {
+		for (int c = c0; c <= c1; c++) {
+			struct magnet_cell *cell = &cells[r * cols + c];
+			if (cell->n && cell->windows[cell->n - 1] == i)
+				continue;
+			if (cell->n < MAGNET_CELL_MAX)
+				cell->windows[cell->n++] = i;
+		}
+	}
+}
+
+static void magnet_rebuild()
+{
+	memset(cells, 0x0, cols * rows * sizeof(struct magnet_cell));
+
+	for (int i = 0; i < nwindows; i++) {
+		struct magnet_window *w = &windows[i];
+		int x1 = w->x + w->width, y1 = w->y + w->height;
+		int cx = w->x + w->width / 2, cy = w->y + w->height / 2;
+
+		if (!w->mapped)
+			continue;
+
+		magnet_file(i, w->x - radius, w->y - radius, x1 + radius, w->y + radius);
+		magnet_file(i, w->x - radius, y1 - radius, x1 + radius, y1 + radius);
+		magnet_file(i, w->x - radius, w->y - radius, w->x + radius, y1 + radius);
+		magnet_file(i, x1 - radius, w->y - radius, x1 + radius, y1 + radius);
+		magnet_file(i, cx - radius, cy - radius, cx + radius, cy + radius);
+	}
+
+	cells_valid = 1;
+}
+
+/*
+ * Start tracking the top-level windows on d's default screen.
+ * Targets further than radius pixels away are ignored.
+ */
+int magnet_init(Display *d, int r)
+{
+	Window rootret, parent, *children;
+	unsigned n;
+
+	if (d == NULL) return -1;
+
+	display = d;
+	root = RootWindow(d, DefaultScreen(d));
+	radius = r;
+	cols = (XDisplayWidth(d, DefaultScreen(d))  + MAGNET_CELL_SIZE - 1) / MAGNET_CELL_SIZE;
+	rows = (XDisplayHeight(d, DefaultScreen(d)) + MAGNET_CELL_SIZE - 1) / MAGNET_CELL_SIZE;
+	if ((cells = calloc(cols * rows, sizeof(struct magnet_cell))) == NULL)
+		return -1;
+
+	/* Listen first, so nothing changes unseen between here and the query. */
+	XWindowAttributes rootattr;
+	if (!XGetWindowAttributes(d, root, &rootattr))
+		return -1;
+	XSelectInput(d, root, rootattr.your_event_mask | SubstructureNotifyMask);
+
+	if (!XQueryTree(d, root, &rootret, &parent, &children, &n))
+		return -1;
+
+	for (unsigned i = 0; i < n; i++) {
+		XWindowAttributes attr;
+		if (!XGetWindowAttributes(d, children[i], &attr) || attr.override_redirect)
+			continue;
+
+		struct magnet_window *w = magnet_add(children[i]);
+		if (w == NULL)
+			break;
+		w->x = attr.x;
+		w->y = attr.y;
+		w->width  = attr.width + 2 * attr.border_width;
+		w->height = attr.height + 2 * attr.border_width;
+		w->mapped = attr.map_state == IsViewable;
+	}
+
+	if (children)
+		XFree(children);
+	cells_valid = 0;
+	return 0;
+}
+
+/* Update the window list from an event on the root window. */
+void magnet_event(const XEvent *xev)
+{
+	struct magnet_window *w;
+
+	if (cells == NULL)
+		return;
+
+	switch (xev->type) {
+		/* New top-level windows start out unmapped, until MapNotify. */
+		case CreateNotify:
+			if (xev->xcreatewindow.parent != root ||
+			    xev->xcreatewindow.override_redirect)
+				return;
+			if ((w = magnet_add(xev->xcreatewindow.window)) == NULL)
+				return;
+			w->x = xev->xcreatewindow.x;
+			w->y = xev->xcreatewindow.y;
+			w->width  = xev->xcreatewindow.width + 2 * xev->xcreatewindow.border_width;
+			w->height = xev->xcreatewindow.height + 2 * xev->xcreatewindow.border_width;
+			w->mapped = 0;
+			break;
+
+		case ConfigureNotify:
+			if (xev->xconfigure.event != root || xev->xconfigure.override_redirect)
+				return;
+			if ((w = magnet_add(xev->xconfigure.window)) == NULL)
+				return;
+			w->x = xev->xconfigure.x;
+			w->y = xev->xconfigure.y;
+			w->width  = xev->xconfigure.width + 2 * xev->xconfigure.border_width;
+			w->height = xev->xconfigure.height + 2 * xev->xconfigure.border_width;
+			break;
+
+		case MapNotify:
+			if (xev->xmap.event != root || xev->xmap.override_redirect)
+				return;
+			if ((w = magnet_find(xev->xmap.window)) == NULL)
+				return;
+			w->mapped = 1;
+			break;
+
+		case UnmapNotify:
+			if (xev->xunmap.event != root)
+				return;
+			if ((w = magnet_find(xev->xunmap.window)) == NULL)
+				return;
+			w->mapped = 0;
+			break;
+
+		case DestroyNotify:
+			if (xev->xdestroywindow.event != root)
+				return;
+			magnet_remove(xev->xdestroywindow.window);
+			break;
+
+		default:
+			return;
+	}
+
+	cells_valid = 0;
+}
+
+/* Consider the target (px, py) for magnet_nearest(). */
+static void magnet_consider(int x, int y, int dx, int dy, int px, int py,
+                            long limit, long *best, int *tx, int *ty)
+{
+	long ex = px - x, ey = py - y;
+	long d2 = ex * ex + ey * ey;
+
+	/* Only pull forwards, never back against the motion. */
+	if (ex * dx + ey * dy < 0)
+		return;
+
+	if (d2 <= limit && (*best < 0 || d2 < *best)) {
+		*best = d2;
+		*tx = px;
+		*ty = py;
+	}
+}
+
+/*
+ * Find the nearest target within distance of (x, y), not behind the
+ *  direction of travel (dx, dy). distance is capped at the radius.
+ * A target is a window's middle, or the nearest point on its edges.
+ * Returns 0 if there is none.
+ */
+int magnet_nearest(int x, int y, int dx, int dy, int distance, int *tx, int *ty)
+{
+	long best = -1;
+
+	if (cells == NULL || radius <= 0)
+		return 0;
+	if (distance > radius)
+		distance = radius;
+	long limit = (long)distance * distance;
+	if (!cells_valid)
+		magnet_rebuild();
+
+	int c = x / MAGNET_CELL_SIZE, r = y / MAGNET_CELL_SIZE;
+	if (x < 0 || y < 0 || c >= cols || r >= rows)
+		return 0;
+
+	struct magnet_cell *cell = &cells[r * cols + c];
+	for (int i = 0; i < cell->n; i++) {
+		struct magnet_window *w = &windows[cell->windows[i]];
+		int x1 = w->x + w->width - 1, y1 = w->y + w->height - 1;
+
+		/* The point of each edge nearest the cursor. */
+		int cx = x < w->x ? w->x : (x > x1 ? x1 : x);
+		int cy = y < w->y ? w->y : (y > y1 ? y1 : y);
+		magnet_consider(x, y, dx, dy, cx, w->y, limit, &best, tx, ty);
+		magnet_consider(x, y, dx, dy, cx, y1, limit, &best, tx, ty);
+		magnet_consider(x, y, dx, dy, w->x, cy, limit, &best, tx, ty);
+		magnet_consider(x, y, dx, dy, x1, cy, limit, &best, tx, ty);
+
+		magnet_consider(x, y, dx, dy, w->x + w->width / 2, w->y + w->height / 2,
+		                limit, &best, tx, ty);
+	}
+
+	return best >= 0;
+}
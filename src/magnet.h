@@ -0,0 +1,39 @@
+/*
+ * magnet.h
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __mousepad_magnet_h__
+#define __mousepad_magnet_h__
+
+#include <X11/X.h>
+#include <X11/Xlib.h>
+
+/* Side of one square cell of the spatial index, in pixels. */
+#define MAGNET_CELL_SIZE 128
+
+/* Windows indexed per cell; any more in one cell are not attractors. */
+#define MAGNET_CELL_MAX 16
+
+#define MAGNET_MAX_WINDOWS 512
+
+int magnet_init(Display *d, int radius);
+void magnet_event(const XEvent *xev);
+int magnet_nearest(int x, int y, int dx, int dy, int distance, int *tx, int *ty);
+
+#endif /* __mousepad_magnet_h__ */
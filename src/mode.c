@@ -0,0 +1,171 @@
+/*
+ * mode.c
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mode.h"
+#include "config.h"
+#include "gesture.h"
+#include "keyboard.h"
+#include "mouse.h"
+#include "repeat.h"
+#include "steno.h"
+
+#include <stddef.h>
+
+/*
+ * Everything the dispatcher needs from a mode. Button changes reach
+ *  the mode through the gesture table its begin hook installs; the rest
+ *  are called directly, and may be NULL if the mode has no use for them.
+ * Every mode is initialized at startup, with its windows realized and
+ *  its tables built, so a switch is just an end hook and a begin hook.
+ *
+ * lend is called when the other mode's hybrid button is pressed, and
+ *  lends that mode this one's gestures; reclaim is called on release.
+ */
+static const struct
+{
+	void (*begin)();
+	void (*end)();
+	void (*axis)(int axis, int value);
+	int (*moving)();
+	void (*tick)(long long now);
+	void (*lend)();
+	void (*reclaim)();
+} modes[NMODES] = {
+	[MODE_MOUSE]    = { mouse_begin, mouse_end, mouse_axis, mouse_moving,
+	                    mouse_tick, mouse_lend, NULL },
+	[MODE_KEYBOARD] = { keyboard_begin, keyboard_end, NULL, NULL, NULL,
+	                    keyboard_lend, keyboard_reclaim },
+	[MODE_STENO]    = { steno_begin, steno_end, NULL, NULL, NULL, NULL, NULL },
+};
+
+static int mode = MODE_NONE;
+static int enabled[NMODES] = { 1, 1, 0 };
+
+/* Held in each mode to borrow the other's actions. */
+static button_t hybrid[NMODES];
+
+static int lender = MODE_NONE; /* Mode whose actions are borrowed now. */
+static int lent = 0;           /* Bits of the modes lent since the switch. */
+
+/* Read the optional modes and hybrid buttons from the settings file. */
+void mode_init()
+{
+	enabled[MODE_STENO] = config_int("steno_mode", 0);
+
+	hybrid[MODE_MOUSE] = config_button("mouse_hybrid_button", BUTTON_START);
+	/* Start and Back select layers in keyboard mode, so neither is taken. */
+	hybrid[MODE_KEYBOARD] = config_button("keyboard_hybrid_button", 0);
+}
+
+/* The mode's hybrid button was pressed or released. */
+static void mode_borrow(int held)
+{
+	int other = (mode == MODE_MOUSE) ? MODE_KEYBOARD : MODE_MOUSE;
+
+	if (held) {
+		lender = other;
+		lent |= 1 << other;
+		modes[other].lend();
+	} else if (lender != MODE_NONE) {
+		if (modes[lender].reclaim)
+			modes[lender].reclaim();
+		lender = MODE_NONE;
+	}
+}
+
+/* Called by a mode after each gesture_use(), to keep its hybrid button. */
+void mode_use_hybrid()
+{
+	if (mode != MODE_NONE && hybrid[mode])
+		gesture_hybrid(hybrid[mode], mode_borrow);
+}
+
+/* Leave the current mode, if any, and enter another. */
+void mode_switch(int m)
+{
+	mode_end();
+	mode = m;
+	modes[mode].begin();
+}
+
+/* Gesture action: switch to the next mode that is turned on. */
+void mode_toggle(int unused)
+{
+	int m = mode;
+
+	do
+		m = (m + 1) % NMODES;
+	while (!enabled[m]);
+	mode_switch(m);
+}
+
+/* Leave the current mode, as when the pad goes away. */
+void mode_end()
+{
+	if (mode == MODE_NONE)
+		return;
+
+	repeat_stop();
+	mode_borrow(0);
+	modes[mode].end();
+	mode = MODE_NONE;
+	lent = 0;
+}
+
+int mode_current()
+{
+	return mode;
+}
+
+/* Returns nonzero if mode_toggle() can reach mode m. */
+int mode_enabled(int m)
+{
+	return enabled[m];
+}
+
+/* Axes go to the current mode, or to the one lending it actions. */
+void mode_axis(int axis, int value)
+{
+	int m = (lender != MODE_NONE) ? lender : mode;
+
+	if (m != MODE_NONE && modes[m].axis)
+		modes[m].axis(axis, value);
+}
+
+/*
+ * Returns nonzero if the mode needs mode_tick() called regularly.
+ * A mode that has lent its actions may still be busy with them after
+ *  the hybrid button is released, so it is asked too.
+ */
+int mode_moving()
+{
+	for (int m = 0; m < NMODES; m++)
+		if ((m == mode || (lent & (1 << m))) && modes[m].moving &&
+		    modes[m].moving())
+			return 1;
+	return 0;
+}
+
+void mode_tick(long long now)
+{
+	for (int m = 0; m < NMODES; m++)
+		if ((m == mode || (lent & (1 << m))) && modes[m].tick)
+			modes[m].tick(now);
+}
@@ -0,0 +1,42 @@
+/*
+ * mode.h
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __mousepad_mode_h__
+#define __mousepad_mode_h__
+
+#define MODE_MOUSE    0
+#define MODE_KEYBOARD 1
+#define MODE_STENO    2
+#define NMODES        3
+
+#define MODE_NONE (-1)
+
+void mode_init();
+void mode_use_hybrid();
+void mode_switch(int mode);
+void mode_toggle(int unused);
+void mode_end();
+int mode_current();
+int mode_enabled(int mode);
+void mode_axis(int axis, int value);
+int mode_moving();
+void mode_tick(long long now);
+
+#endif /* __mousepad_mode_h__ */
@@ -19,42 +19,388 @@
  */
 
 #include "mouse.h"
-#include "keyboard.h"
-
+#include "config.h"
+#include "gesture.h"
+#include "gridgtk.h"
+#include "magnet.h"
+#include "mode.h"
+#include "output.h"
+#include "repeat.h"
+#include "ring.h"
+
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
 #include <X11/X.h>
 #include <X11/Xlib.h>
-#include <X11/extensions/XTest.h>
 
-#define MOTION_DAMP 1.0
-#define MOUSE_DELAY_MILLISECONDS 10
-#define MOUSE_MAX_VELOCITY 30.0
-#define MOUSE_VELOCITY 2
-#define MOUSE_ACCELERATION 1
+/* Defaults for the acceleration settings. */
+#define MOUSE_MAX_VELOCITY 3000.0 /* pixels per second */
+#define MOUSE_VELOCITY 200        /* pixels per second */
+#define MOUSE_ACCELERATION 100    /* pixels per second squared */
+#define MOUSE_GROWTH 2.0          /* e-foldings per second, for exponential */
+#define MOUSE_PRECISION_SCALE 0.25
+
+/* Acceleration profiles: how speed grows with the time an arrow is held. */
+#define MOUSE_PROFILE_LINEAR      0 /* velocity + acceleration * t */
+#define MOUSE_PROFILE_EXPONENTIAL 1 /* velocity * exp(growth * t) */
+#define MOUSE_PROFILE_TABLE       2 /* Interpolated from (t, speed) points. */
+
+/* Defaults for the scroll settings, in wheel clicks. */
+#define MOUSE_SCROLL_VELOCITY 8.0      /* clicks per second */
+#define MOUSE_SCROLL_ACCELERATION 16.0 /* clicks per second squared */
+#define MOUSE_SCROLL_MAX_VELOCITY 60.0
+
+/* Pad axes that may be bound to the cursor. */
+#define MOUSE_MAX_AXES 8
+
+/* Defaults for the axis settings. */
+#define MOUSE_AXIS_DEADZONE 0.1
+#define MOUSE_AXIS_CURVE 2.0
+#define MOUSE_AXIS_SPEED 2000.0 /* pixels per second at full deflection */
+
+/* Defaults for the magnet settings. */
+#define MOUSE_MAGNET_RADIUS 0     /* pixels; 0 turns magnetism off */
+#define MOUSE_MAGNET_STRENGTH 8.0 /* fraction of the gap closed per second */
+#define MOUSE_MAGNET_SNAP 12      /* pixels */
+
+/* After a longer stall than this, motion resumes rather than catching up. */
+#define MOUSE_MAX_LAG_NSEC (100 * NSEC_PER_MSEC)
 
 mouse_t mouse;
-Display *display;
+static Display *display;
+static int screen_width, screen_height;
+
+/* Acceleration from the settings, and the one in use, maybe a profile's. */
+static mouse_accel_t accel_default;
+static const mouse_accel_t *accel = &accel_default;
+
+static int precise = 0; /* The precision button is held. */
+
+/*
+ * Analog axes: the position of a bound axis sets the cursor's velocity
+ *  along x or y directly, after calibration, a deadzone, and a curve.
+ */
+static struct mouse_axis
+{
+	double *velocity; /* &mouse.xs or &mouse.ys, or NULL if unbound. */
+	int sign;
+	int min, center, max; /* Calibrated range of the raw values. */
+	double deadzone;      /* Fraction of the range around center ignored. */
+	double curve;         /* Exponent applied to the deflection. */
+	double speed;
+} axes[MOUSE_MAX_AXES];
+
+/* Magnetism toward nearby windows, if magnet_radius is set. */
+static struct
+{
+	int radius, snap;
+	double strength;
+} magnet;
 
-struct timespec prevtime;  // Time since last mouse_tick().
+/* Where the cursor was when each arrow was last pressed, for rollbacks. */
+static int pressed_x[NBUTTONS], pressed_y[NBUTTONS];
 
-/* Returns the difference in milliseconds between two times. */
-static int millidiff(struct timespec time, struct timespec prev)
+/*
+ * Parse the mouse_table setting: pairs of seconds held and speed,
+ *  in order of time. Returns -1 if it is malformed.
+ */
+static int mouse_read_table(mouse_accel_t *a, const char *text)
 {
-	return abs(((time.tv_sec  - prev.tv_sec)  * 1000) +
-	           ((time.tv_nsec - prev.tv_nsec) / 1000000));
+	char *end;
+
+	a->npoints = 0;
+	while (a->npoints < MOUSE_TABLE_POINTS) {
+		double t = strtod(text, &end);
+		if (end == text)
+			break;
+		text = end;
+		double v = strtod(text, &end);
+		if (end == text)
+			return -1;
+		text = end;
+
+		if (a->npoints && t <= a->time[a->npoints - 1])
+			return -1;
+		a->time[a->npoints] = t;
+		a->speed[a->npoints] = v;
+		a->npoints++;
+	}
+
+	return a->npoints ? 0 : -1;
+}
+
+/*
+ * Read an acceleration profile from the settings file, within whichever
+ *  section config_section() has selected.
+ */
+int mouse_read_accel(mouse_accel_t *a)
+{
+	const char *profile = config_string("mouse_profile", "linear");
+
+	a->velocity     = config_float("mouse_velocity", MOUSE_VELOCITY);
+	a->acceleration = config_float("mouse_acceleration", MOUSE_ACCELERATION);
+	a->growth       = config_float("mouse_growth", MOUSE_GROWTH);
+	a->max_velocity = config_float("mouse_max_velocity", MOUSE_MAX_VELOCITY);
+	a->scroll_velocity = config_float("scroll_velocity", MOUSE_SCROLL_VELOCITY);
+	a->scroll_acceleration = config_float("scroll_acceleration",
+	                                         MOUSE_SCROLL_ACCELERATION);
+	a->scroll_max_velocity = config_float("scroll_max_velocity",
+	                                         MOUSE_SCROLL_MAX_VELOCITY);
+	a->precision_button = config_button("precision_button", BUTTON_BACK);
+	a->precision_scale  = config_float("precision_scale", MOUSE_PRECISION_SCALE);
+
+	if (!strcmp(profile, "linear")) {
+		a->profile = MOUSE_PROFILE_LINEAR;
+	} else if (!strcmp(profile, "exponential")) {
+		a->profile = MOUSE_PROFILE_EXPONENTIAL;
+	} else if (!strcmp(profile, "table")) {
+		a->profile = MOUSE_PROFILE_TABLE;
+		if (mouse_read_table(a, config_string("mouse_table", "")) < 0) {
+			fprintf(stderr, " Bad mouse_table setting.\n");
+			return -1;
+		}
+	} else {
+		fprintf(stderr, " Unknown mouse_profile \"%s\".\n", profile);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Read the axis bindings from the settings file, as axis0_deadzone etc. */
+static int mouse_read_axes()
+{
+	char key[32];
+
+	for (int i = 0; i < MOUSE_MAX_AXES; i++) {
+		struct mouse_axis *a = &axes[i];
+
+		snprintf(key, sizeof(key), "axis%d", i);
+		const char *bind = config_string(key, "none");
+		a->sign = (bind[0] == '-') ? -1 : 1;
+		if (bind[0] == '-')
+			bind++;
+
+		if (!strcmp(bind, "x")) {
+			a->velocity = &mouse.xs;
+		} else if (!strcmp(bind, "y")) {
+			a->velocity = &mouse.ys;
+		} else if (!strcmp(bind, "none")) {
+			a->velocity = NULL;
+		} else {
+			fprintf(stderr, " Axis %d must be bound to x, y or none.\n", i);
+			return -1;
+		}
+
+		snprintf(key, sizeof(key), "axis%d_min", i);
+		a->min = config_int(key, -PADEVENT_AXIS_MAX);
+		snprintf(key, sizeof(key), "axis%d_center", i);
+		a->center = config_int(key, 0);
+		snprintf(key, sizeof(key), "axis%d_max", i);
+		a->max = config_int(key, PADEVENT_AXIS_MAX);
+		snprintf(key, sizeof(key), "axis%d_deadzone", i);
+		a->deadzone = config_float(key, MOUSE_AXIS_DEADZONE);
+		snprintf(key, sizeof(key), "axis%d_curve", i);
+		a->curve = config_float(key, MOUSE_AXIS_CURVE);
+		snprintf(key, sizeof(key), "axis%d_speed", i);
+		a->speed = config_float(key, MOUSE_AXIS_SPEED);
+
+		if (a->velocity && (a->min >= a->center || a->center >= a->max ||
+		                    a->deadzone < 0 || a->deadzone >= 1)) {
+			fprintf(stderr, " Bad calibration for axis %d.\n", i);
+			return -1;
+		}
+	}
+
+	return 0;
 }
 
 /* Mouse initialization. */
 int mouse_init(Display *d)
 {
 	if (d == NULL) return -1;
+	if (mouse_read_accel(&accel_default) < 0) return -1;
+	if (mouse_read_axes() < 0) return -1;
 
 	display = d;
-	clock_gettime(CLOCK_REALTIME, &prevtime);
-	return 0;
+	screen_width  = XDisplayWidth(d, DefaultScreen(d));
+	screen_height = XDisplayHeight(d, DefaultScreen(d));
+
+	magnet.radius   = config_int("magnet_radius", MOUSE_MAGNET_RADIUS);
+	magnet.snap     = config_int("magnet_snap", MOUSE_MAGNET_SNAP);
+	magnet.strength = config_float("magnet_strength", MOUSE_MAGNET_STRENGTH);
+	if (magnet.radius > 0 && magnet_init(d, magnet.radius) < 0)
+		magnet.radius = 0;
+
+	return gridgtk_init(d);
+}
+
+/*
+ * Accelerate by a, such as an application profile's settings,
+ *  or by the settings file's again if a is NULL.
+ */
+void mouse_use_accel(const mouse_accel_t *a)
+{
+	accel = a ? a : &accel_default;
+}
+
+static void mouse_gesture_click(int button)
+{
+	mouse_click(button);
+	if (repeat_clicks())
+		repeat_start(gesture_acting(), mouse_gesture_click, button);
+}
+
+static void mouse_gesture_close(int unused)
+{
+	mouse_close_focused_window();
+}
+
+/*
+ * Scroll lock: the cardinal arrows turn the wheel instead of moving the
+ *  cursor, for reading long documents. Clicks still work as usual.
+ */
+static int scroll_lock = 0;
+
+static void mouse_gesture_scroll_lock(int unused)
+{
+	scroll_lock = !scroll_lock;
+	mouse.xa = mouse.ya = 0;
+	mouse.xv = mouse.yv = 0;
+	mouse.wx = mouse.wy = 0;
+}
+
+/*
+ * The arrows in undone started moving the cursor, but were the start
+ *  of a click instead: stop them, and put the cursor back where it was.
+ */
+static void mouse_rollback(buttonstate_t undone, button_t first)
+{
+	if (undone & (BUTTON_LEFT | BUTTON_RIGHT)) {
+		mouse.xa = mouse.xv = 0;
+		mouse.wx = 0;
+	}
+	if (undone & (BUTTON_UP | BUTTON_DOWN)) {
+		mouse.ya = mouse.yv = 0;
+		mouse.wy = 0;
+	}
+
+	mouse_warp(pressed_x[button_index(first)], pressed_y[button_index(first)]);
+}
+
+static void mouse_grid_begin(int unused);
+
+/* Button combinations with actions of their own in mouse mode. */
+static const struct gesture mouse_gestures[] = {
+	/* Jump on the left and right arrows to left-click. */
+	{ GESTURE_CHORD, BUTTON_LEFT | BUTTON_RIGHT, 0, mouse_gesture_click, MOUSE_BUTTON_LEFT },
+	/* Jump on the up and down arrows to right-click. */
+	{ GESTURE_CHORD, BUTTON_UP | BUTTON_DOWN, 0, mouse_gesture_click, MOUSE_BUTTON_RIGHT },
+	{ GESTURE_PRESS, BUTTON_UPLEFT, 0, mouse_gesture_close, 0 },
+	{ GESTURE_DOUBLETAP, BUTTON_BACK, 0, mouse_gesture_scroll_lock, 0 },
+	/* Tap Start on its own to switch to keyboard mode. */
+	{ GESTURE_TAP, BUTTON_START, 0, mode_toggle, 0 },
+	{ GESTURE_PRESS, BUTTON_DOWNLEFT, 0, mouse_grid_begin, 0 },
+};
+
+static void mouse_use_gestures()
+{
+	gesture_use(mouse_gestures, sizeof(mouse_gestures) / sizeof(mouse_gestures[0]),
+	            mouse_event);
+	gesture_speculate(mouse_rollback);
+	mode_use_hybrid();
+}
+
+/*
+ * Grid mode: a 3x3 grid is drawn over a region of the screen, starting
+ *  with all of it. Each arrow warps the cursor to the middle of the
+ *  matching cell, and Back to the middle cell; the region then shrinks
+ *  to that cell. Any pixel is a handful of presses away.
+ * Tapping Start leaves grid mode, as does running out of cells to divide.
+ */
+static struct
+{
+	int active;
+	int x, y, width, height;
+} grid;
+
+static const struct
+{
+	button_t button;
+	int col, row;
+} grid_cells[] = {
+	{ BUTTON_UPLEFT,   0, 0 }, { BUTTON_UP,   1, 0 }, { BUTTON_UPRIGHT,   2, 0 },
+	{ BUTTON_LEFT,     0, 1 }, { BUTTON_BACK, 1, 1 }, { BUTTON_RIGHT,     2, 1 },
+	{ BUTTON_DOWNLEFT, 0, 2 }, { BUTTON_DOWN, 1, 2 }, { BUTTON_DOWNRIGHT, 2, 2 },
+};
+
+static void mouse_grid_end()
+{
+	if (!grid.active)
+		return;
+
+	grid.active = 0;
+	gridgtk_hide();
+	mouse_use_gestures();
+}
+
+static void mouse_grid_event(buttonstate_t buttons, button_t changed)
+{
+	if (!(buttons & changed))
+		return;
+
+	for (int i = 0; i < sizeof(grid_cells) / sizeof(grid_cells[0]); i++) {
+		if (grid_cells[i].button != changed)
+			continue;
+
+		int col = grid_cells[i].col, row = grid_cells[i].row;
+		int x0 = grid.x + grid.width  * col / 3;
+		int x1 = grid.x + grid.width  * (col + 1) / 3;
+		int y0 = grid.y + grid.height * row / 3;
+		int y1 = grid.y + grid.height * (row + 1) / 3;
+
+		grid.x = x0;
+		grid.y = y0;
+		grid.width  = x1 - x0;
+		grid.height = y1 - y0;
+		mouse_warp(grid.x + grid.width / 2, grid.y + grid.height / 2);
+
+		/* gridgtk_show() can't draw a cell this thin on either side. */
+		if (grid.width < 3 || grid.height < 3)
+			mouse_grid_end();
+		else
+			gridgtk_show(grid.x, grid.y, grid.width, grid.height);
+		return;
+	}
+}
+
+static void mouse_gesture_grid_end(int unused)
+{
+	mouse_grid_end();
+}
+
+/* Grid mode has a table of its own, so Start does not switch modes too. */
+static const struct gesture mouse_grid_gestures[] = {
+	{ GESTURE_TAP, BUTTON_START, 0, mouse_gesture_grid_end, 0 },
+};
+
+static void mouse_grid_begin(int unused)
+{
+	mouse.xa = mouse.ya = 0;
+	mouse.xv = mouse.yv = 0;
+
+	grid.active = 1;
+	grid.x = grid.y = 0;
+	grid.width  = screen_width;
+	grid.height = screen_height;
+
+	gesture_use(mouse_grid_gestures,
+	            sizeof(mouse_grid_gestures) / sizeof(mouse_grid_gestures[0]),
+	            mouse_grid_event);
+	gridgtk_show(grid.x, grid.y, grid.width, grid.height);
 }
 
 /*
@@ -64,29 +410,76 @@ int mouse_init(Display *d)
 void mouse_begin()
 {
 	memset(&mouse, 0x0, sizeof(mouse_t));
+	precise = 0;
+	scroll_lock = 0;
+	mouse_use_gestures();
+	mouse_sync();
 }
 
 /* End mouse mode. */
 void mouse_end()
 {
-	return;
+	mouse_grid_end();
 }
 
-/* Moves the mouse relatively. */
-void mouse_move(int xdelta, int ydelta)
+/*
+ * Lend the pointer to keyboard mode while its hybrid button is held.
+ * Only the clicks are reachable then: the other gestures need their
+ *  button pressed on its own.
+ */
+void mouse_lend()
+{
+	/* Arrows still held from the last time keep moving the cursor. */
+	if (!mouse_moving()) {
+		memset(&mouse, 0x0, sizeof(mouse_t));
+		precise = 0;
+		scroll_lock = 0;
+		mouse_sync();
+	}
+
+	gesture_borrow(mouse_gestures, sizeof(mouse_gestures) / sizeof(mouse_gestures[0]),
+	               mouse_event);
+}
+
+/*
+ * Re-read the pointer position from the server.
+ * This waits for queued motion and a round-trip, so it is only done while
+ *  the cursor is at rest; in between, mouse.x and mouse.y are tracked locally.
+ */
+void mouse_sync()
 {
 	Window w;
 	unsigned tmp;
 	int tmp2;
 
-	/* Obtain mouse position. */
+	output_drain();
 	XQueryPointer(display, RootWindow(display, DefaultScreen(display)), &w, &w,
 	              &mouse.x, &mouse.y, &tmp2, &tmp2, &tmp);
+}
+
+/* Moves the mouse relatively, without asking the server where it is. */
+void mouse_move(int xdelta, int ydelta)
+{
+	if (xdelta == 0 && ydelta == 0)
+		return;
+
+	output_motion(xdelta, ydelta);
 
-	/* Move mouse. */
-	XWarpPointer(display, None, RootWindow(display, DefaultScreen(display)),
-	             0, 0, 0, 0, mouse.x + xdelta, mouse.y + ydelta);
-	XFlush(display);
+	/* The server stops the pointer at the screen edges. */
+	mouse.x += xdelta;
+	mouse.y += ydelta;
+	if (mouse.x < 0) mouse.x = 0;
+	if (mouse.y < 0) mouse.y = 0;
+	if (mouse.x >= screen_width)  mouse.x = screen_width - 1;
+	if (mouse.y >= screen_height) mouse.y = screen_height - 1;
+}
+
+/* Moves the mouse to a position on the screen. */
+void mouse_warp(int x, int y)
+{
+	output_warp(x, y);
+	mouse.x = x;
+	mouse.y = y;
 }
 
 /* 
@@ -95,11 +488,8 @@ void mouse_move(int xdelta, int ydelta)
  */
 void mouse_click(unsigned button)
 {
-
-	XTestFakeButtonEvent(display, button, 1, 0);
-	XTestFakeButtonEvent(display, button, 0, 0);
-
-	XFlush(display);
+	output_button(button, True);
+	output_button(button, False);
 }
 
 /* Closes the currently focused window by sending an XDestroy message. */
@@ -110,120 +500,281 @@ void mouse_close_focused_window()
 	int revert;
 
 	XGetInputFocus(display, &focused, &revert);
-	if (focused != None)
+	if (focused != None) {
 		XDestroyWindow(display, focused);
+		XFlush(display);
+	}
 }
 
-/* Handle a tick event by moving the cursor if necessary. */
-void mouse_tick()
+/* Returns nonzero if the cursor is in motion and needs ticks. */
+int mouse_moving()
 {
-	if (mouse.xa == 0 && mouse.ya == 0)
-		return;
-
-	/* Time-based delay. */
-	struct timespec time;
-	clock_gettime(CLOCK_REALTIME, &time);
-	if (millidiff(time, prevtime) < MOUSE_DELAY_MILLISECONDS)
-		return;
+	return mouse.xa != 0 || mouse.ya != 0 || mouse.xs != 0 || mouse.ys != 0 ||
+	       mouse.wx != 0 || mouse.wy != 0;
+}
 
-	/* Update velocities. */
-	float curve = ((float)millidiff(time, prevtime))/1000.0*MOTION_DAMP;
+/* Returns the speed of an axis that has been accelerating for t seconds. */
+static double mouse_speed(double t)
+{
+	double v;
 
-	if (mouse.xa == 0)
-		mouse.xv = 0;
-	else
-		mouse.xv += mouse.xa * curve;
+	switch (accel->profile) {
+		case MOUSE_PROFILE_EXPONENTIAL:
+			v = accel->velocity * exp(accel->growth * t);
+			break;
 
-	if (mouse.ya == 0)
-		mouse.yv = 0;
-	else
-		mouse.yv += mouse.ya * curve;
+		case MOUSE_PROFILE_TABLE: {
+			int i = 1;
+			while (i < accel->npoints && accel->time[i] < t)
+				i++;
+			if (t <= accel->time[0]) {
+				v = accel->speed[0];
+			} else if (i == accel->npoints) {
+				v = accel->speed[accel->npoints - 1];
+			} else {
+				double f = (t - accel->time[i - 1]) /
+				           (accel->time[i] - accel->time[i - 1]);
+				v = accel->speed[i - 1] +
+				    f * (accel->speed[i] - accel->speed[i - 1]);
+			}
+			break;
+		}
 
-	/* Cap velocities. */
-	if (abs((int)mouse.xv) > MOUSE_MAX_VELOCITY)
-		mouse.xv = MOUSE_MAX_VELOCITY;
-	if (abs((int)mouse.yv) > MOUSE_MAX_VELOCITY)
-		mouse.yv = MOUSE_MAX_VELOCITY;
+		default:
+			v = accel->velocity + accel->acceleration * t;
+			break;
+	}
 
-	/* Handle movement. */
-	mouse_move((int)mouse.xv, (int)mouse.yv);
-	prevtime = time;
+	if (v > accel->max_velocity)
+		v = accel->max_velocity;
+	if (precise)
+		v *= accel->precision_scale;
+	return v;
 }
 
-/* Handle a mouse event by performing an action or changing mouse state. */
-void mouse_event(buttonstate_t buttons, button_t changed)
+/*
+ * Handle a tick event by moving the cursor if necessary.
+ * Ticks are paced by the caller, every MOUSE_DELAY_MILLISECONDS
+ *  for as long as mouse_moving() holds, but may arrive late. Motion is
+ *  integrated in fixed steps of MOUSE_STEP_NSEC up to now, so the path
+ *  taken doesn't depend on when the ticks happen to land.
+ */
+void mouse_tick(long long now)
 {
-	if (!changed) return;
+	const double dt = (double)MOUSE_STEP_NSEC / NSEC_PER_SEC;
 
-	/* Press left and right buttons at the same time to left-click. */
-	if (buttons == (BUTTON_LEFT | BUTTON_RIGHT) &&
-	    (changed & (BUTTON_LEFT | BUTTON_RIGHT))) {
-		mouse_click(MOUSE_BUTTON_LEFT);
+	if (!mouse_moving())
 		return;
-	}
 
-	/* Press up and down buttons at the same time to right-click. */
-	if (buttons == (BUTTON_UP | BUTTON_DOWN) &&
-	    (changed & (BUTTON_UP | BUTTON_DOWN))) {
-		mouse_click(MOUSE_BUTTON_RIGHT);
-		return;
+	if (now - mouse.time > MOUSE_MAX_LAG_NSEC)
+		mouse.time = now - MOUSE_MAX_LAG_NSEC;
+
+	int steps = 0;
+	while (mouse.time + MOUSE_STEP_NSEC <= now) {
+		/* Update velocities from the profile. */
+		if (mouse.xa != 0)
+			mouse.xt += dt;
+		if (mouse.ya != 0)
+			mouse.yt += dt;
+		mouse.xv = mouse.xa * mouse_speed(mouse.xt);
+		mouse.yv = mouse.ya * mouse_speed(mouse.yt);
+
+		double scale = precise ? accel->precision_scale : 1.0;
+		mouse.xr += (mouse.xv + mouse.xs * scale) * dt;
+		mouse.yr += (mouse.yv + mouse.ys * scale) * dt;
+
+		/* The wheel speeds up linearly for as long as it turns. */
+		if (mouse.wx != 0 || mouse.wy != 0) {
+			double w = accel->scroll_velocity +
+			           accel->scroll_acceleration * mouse.wt;
+			if (w > accel->scroll_max_velocity)
+				w = accel->scroll_max_velocity;
+			mouse.wt += dt;
+			mouse.wxr += mouse.wx * w * scale * dt;
+			mouse.wyr += mouse.wy * w * scale * dt;
+		}
+		mouse.time += MOUSE_STEP_NSEC;
+		steps++;
 	}
 
-	/* Press the up-left button (and no other button) to close the window. */
-	if (buttons == BUTTON_UPLEFT && changed == BUTTON_UPLEFT) {
-		mouse_close_focused_window();
-		return;
+	/* Bend the path toward the nearest target ahead. */
+	int tx, ty;
+	if (magnet.radius > 0 && steps &&
+	    magnet_nearest(mouse.x, mouse.y, (int)(mouse.xv + mouse.xs),
+	                   (int)(mouse.yv + mouse.ys), magnet.radius, &tx, &ty)) {
+		double pull = magnet.strength * steps * dt;
+		if (pull > 1.0)
+			pull = 1.0;
+		mouse.xr += (tx - mouse.x) * pull;
+		mouse.yr += (ty - mouse.y) * pull;
 	}
 
-	/* Press the up-right button (and no other button) to scroll up. */
-	if (buttons == BUTTON_UPRIGHT && changed == BUTTON_UPRIGHT) {
-		keyboard_press(XK_Page_Up);
-		return;
-	}
+	/* Send whole wheel clicks, likewise. */
+	for (; mouse.wyr >= 1.0; mouse.wyr -= 1.0)
+		mouse_click(MOUSE_BUTTON_WHEEL_DOWN);
+	for (; mouse.wyr <= -1.0; mouse.wyr += 1.0)
+		mouse_click(MOUSE_BUTTON_WHEEL_UP);
+	for (; mouse.wxr >= 1.0; mouse.wxr -= 1.0)
+		mouse_click(MOUSE_BUTTON_WHEEL_RIGHT);
+	for (; mouse.wxr <= -1.0; mouse.wxr += 1.0)
+		mouse_click(MOUSE_BUTTON_WHEEL_LEFT);
+
+	/* Send whole pixels, and carry the fractions into the next tick. */
+	int dx = (int)mouse.xr;
+	int dy = (int)mouse.yr;
+	mouse.xr -= dx;
+	mouse.yr -= dy;
+	mouse_move(dx, dy);
+}
+
+/*
+ * Handle a mouse event by changing mouse state.
+ * Clicks and other actions are recognized by the gesture engine first;
+ *  arrows that may be half of a click still move the cursor straight
+ *  away, and are rolled back by mouse_rollback() if the click happens.
+ */
+void mouse_event(buttonstate_t buttons, button_t changed)
+{
+	if (!changed) return;
 
-	/* Press the down-right button (and no other button) to scroll down. */
-	if (buttons == BUTTON_DOWNRIGHT && changed == BUTTON_DOWNRIGHT) {
-		keyboard_press(XK_Page_Down);
-		return;
-	}
-	
 	/* 
 	 * If a cardinal button is pushed, accelerate in that direction,
 	 * or halt motion in that direction. This permits moving diagonally
 	 * by pressing multiple cardinal buttons.
 	 */
-	int accel = 0;
-	int vel   = 0;
+	int moving = mouse_moving();
+	int dir = 0;
+
+	/* The precision button scales speed for as long as it is held. */
+	if (changed == accel->precision_button) {
+		precise = (buttons & changed) != 0;
+		mouse.xv = mouse.xa * mouse_speed(mouse.xt);
+		mouse.yv = mouse.ya * mouse_speed(mouse.yt);
+		return;
+	}
+
 	if (buttons & changed) {
-		accel = MOUSE_ACCELERATION;
-		vel   = MOUSE_VELOCITY;
+		pressed_x[button_index(changed)] = mouse.x;
+		pressed_y[button_index(changed)] = mouse.y;
+
+		/* Starting from rest: integrate from now. */
+		if (!moving) {
+			mouse.time = clock_nsec();
+			mouse.xr = mouse.yr = 0;
+			mouse.wxr = mouse.wyr = 0;
+		}
+
+		dir = 1;
+	}
+
+	int xdir = (int)(mouse.xv + mouse.xs), ydir = (int)(mouse.yv + mouse.ys);
+
+	/* Under scroll lock, the cardinal arrows turn the wheel instead. */
+	if (scroll_lock) {
+		switch (changed) {
+			case BUTTON_LEFT:  mouse.wx = -dir; break;
+			case BUTTON_UP:    mouse.wy = -dir; break;
+			case BUTTON_RIGHT: mouse.wx = dir;  break;
+			case BUTTON_DOWN:  mouse.wy = dir;  break;
+		}
+		if (changed & (BUTTON_LEFT | BUTTON_UP | BUTTON_RIGHT | BUTTON_DOWN)) {
+			mouse.wt = 0;
+			changed = 0;
+		}
 	}
 
 	switch (changed) {
 		case BUTTON_LEFT:
-			mouse.xa = -accel;
-			mouse.xv = -vel;
+			mouse.xa = -dir;
+			mouse.xt = 0;
 			break;
 
 		case BUTTON_UP:
-			mouse.ya = -accel;
-			mouse.yv = -vel;
+			mouse.ya = -dir;
+			mouse.yt = 0;
 			break;
 
 		case BUTTON_RIGHT:
-			mouse.xa = accel;
-			mouse.xv = vel;
+			mouse.xa = dir;
+			mouse.xt = 0;
 			break;
 
 		case BUTTON_DOWN:
-			mouse.ya = accel;
-			mouse.yv = vel;
+			mouse.ya = dir;
+			mouse.yt = 0;
+			break;
+
+		/* Hold up-right or down-right to scroll; the first click is at once. */
+		case BUTTON_UPRIGHT:
+			mouse.wy = -dir;
+			mouse.wt = 0;
+			if (dir)
+				mouse_click(MOUSE_BUTTON_WHEEL_UP);
+			break;
+
+		case BUTTON_DOWNRIGHT:
+			mouse.wy = dir;
+			mouse.wt = 0;
+			if (dir)
+				mouse_click(MOUSE_BUTTON_WHEEL_DOWN);
 			break;
 
 		default:
 			break;
 	}
 
+	mouse.xv = mouse.xa * mouse_speed(mouse.xt);
+	mouse.yv = mouse.ya * mouse_speed(mouse.yt);
+
+	/* Back at rest: pick up anything else that moved the pointer. */
+	if (moving && !mouse_moving()) {
+		int tx, ty;
+
+		mouse_sync();
+
+		/* Settle onto a target just ahead of where the cursor stopped. */
+		if (magnet.radius > 0 &&
+		    magnet_nearest(mouse.x, mouse.y, xdir, ydir, magnet.snap, &tx, &ty))
+			mouse_warp(tx, ty);
+	}
+
 	return;
 }
 
+/* Handle a new position of a pad axis, by changing the cursor's speed. */
+void mouse_axis(int axis, int value)
+{
+	if (axis < 0 || axis >= MOUSE_MAX_AXES || axes[axis].velocity == NULL)
+		return;
+
+	struct mouse_axis *a = &axes[axis];
+	int moving = mouse_moving();
+	double f;
+
+	/* Calibrate to -1 .. 1 either side of the center. */
+	if (value >= a->center)
+		f = (double)(value - a->center) / (a->max - a->center);
+	else
+		f = (double)(value - a->center) / (a->center - a->min);
+	if (f > 1.0)  f = 1.0;
+	if (f < -1.0) f = -1.0;
+
+	/* Ignore the deadzone, and start from zero just outside it. */
+	double mag = fabs(f);
+	if (mag <= a->deadzone)
+		mag = 0;
+	else
+		mag = pow((mag - a->deadzone) / (1.0 - a->deadzone), a->curve);
+
+	*a->velocity = (f < 0 ? -1 : 1) * a->sign * mag * a->speed;
+
+	/* Starting from rest: integrate from now. */
+	if (!moving && mouse_moving()) {
+		mouse.time = clock_nsec();
+		mouse.xr = mouse.yr = 0;
+	}
+
+	/* Back at rest: pick up anything else that moved the pointer. */
+	if (moving && !mouse_moving())
+		mouse_sync();
+}
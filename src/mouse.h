@@ -21,6 +21,7 @@
 #ifndef __mousepad_mouse_h__
 #define __mousepad_mouse_h__
 
+#include "clock.h"
 #include "mousepad.h"
 
 #include <X11/X.h>
@@ -28,22 +29,63 @@
 
 typedef struct
 {
-	float xv, yv; /* velocities */
-	float xa, ya; /* accelerations */
-	int   x, y;   /* positions */
+	double xv, yv;  /* velocities, in pixels per second */
+	double xa, ya;  /* directions of acceleration: -1, 0 or 1 */
+	double xt, yt;  /* seconds each axis has been accelerating */
+	double xs, ys;  /* velocities set by analog axes, in pixels per second */
+	int    wx, wy;  /* directions the wheel is scrolling: -1, 0 or 1 */
+	double wt;      /* seconds the wheel has been scrolling */
+	double wxr, wyr; /* fractions of a wheel click not yet sent */
+	double xr, yr;  /* fractions of a pixel moved but not yet sent */
+	int    x, y;    /* positions, tracked locally between mouse_sync() calls */
+	long long time; /* monotonic time the motion has been integrated up to */
 } mouse_t;
 
+#define MOUSE_TABLE_POINTS 16
+
+/* How the cursor and the wheel speed up, as read from the settings. */
+typedef struct
+{
+	int profile;
+	double velocity, acceleration, growth, max_velocity;
+	int npoints;
+	double time[MOUSE_TABLE_POINTS];  /* Seconds held, increasing. */
+	double speed[MOUSE_TABLE_POINTS]; /* Pixels per second at that time. */
+	double scroll_velocity, scroll_acceleration, scroll_max_velocity;
+	button_t precision_button; /* Slows the cursor while held. */
+	double precision_scale;
+} mouse_accel_t;
+
+/* Interval between mouse_tick() calls while the cursor is moving. */
+#define MOUSE_DELAY_MILLISECONDS 10
+
+/* Physics step, independent of when mouse_tick() actually runs. */
+#define MOUSE_STEP_NSEC (2 * NSEC_PER_MSEC)
+
 #define MOUSE_BUTTON_LEFT Button1
 #define MOUSE_BUTTON_RIGHT 3
 
+/* Wheel clicks are presses of these buttons. */
+#define MOUSE_BUTTON_WHEEL_UP    Button4
+#define MOUSE_BUTTON_WHEEL_DOWN  Button5
+#define MOUSE_BUTTON_WHEEL_LEFT  6
+#define MOUSE_BUTTON_WHEEL_RIGHT 7
+
 int mouse_init(Display *d);
+int mouse_read_accel(mouse_accel_t *a);
+void mouse_use_accel(const mouse_accel_t *a);
 void mouse_begin();
 void mouse_end();
+void mouse_lend();
+void mouse_sync();
 void mouse_move(int xdelta, int ydelta);
+void mouse_warp(int x, int y);
 void mouse_click(unsigned button);
 void mouse_close_focused_window();
-void mouse_tick();
+int mouse_moving();
+void mouse_tick(long long now);
 void mouse_event(buttonstate_t buttons, button_t changed);
+void mouse_axis(int axis, int value);
 
 #endif /* __mousepad_mouse_h__ */
 
@@ -18,6 +18,8 @@
  * along with Mousepad.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "evdev.h"
+
 #include <stdio.h>
 #include <unistd.h>
 #include <errno.h>
@@ -50,6 +52,8 @@
 
 int joyFD;
 int numButtons = 0;
+int isEvdev = 0; /* True if joyFD is an event device, not a joystick */
+short evKeymap[EVDEV_KEYMAP_SIZE]; /* Key code to button number */
 char *configpath;
 
 /* GTK stuff */
@@ -70,6 +74,27 @@ struct btn
 
 /******************************************/
 
+/* Same as get_joystick_input(), but for event devices */
+int get_evdev_input()
+{
+	struct input_event ev;
+	
+	/* Flush the event stack */
+	while (read(joyFD, &ev, sizeof(struct input_event)) > 0);
+	
+	while (1)
+	{
+		if (read(joyFD, &ev, sizeof(struct input_event)) <= 0)
+			continue;
+		
+		if (ev.type == EV_KEY && ev.value == 1 && ev.code <= KEY_MAX && evKeymap[ev.code] >= 0)
+		{
+			gtk_statusbar_pop(statusbar, 0);
+			return evKeymap[ev.code];
+		}
+	}
+}
+
 int get_joystick_input()
 {
 	struct js_event jevent;
@@ -79,6 +104,9 @@ int get_joystick_input()
 	while (gtk_events_pending())
 		gtk_main_iteration();
 	
+	if (isEvdev)
+		return get_evdev_input();
+	
 	/* Flush the event stack */
 	while (read(joyFD, &jevent, sizeof(struct js_event)))
 	{
@@ -419,8 +447,16 @@ int main (int argc, char *argv[])
 		return 1;
 	}
 	
-	/* Retrieve the number of buttons */
-	ioctl(joyFD, JSIOCGBUTTONS, &numButtons);
+	/* Retrieve the number of buttons, numbered as the joystick driver does */
+	if (evdev_probe(joyFD))
+	{
+		isEvdev = 1;
+		numButtons = evdev_keymap(joyFD, evKeymap);
+	}
+	else
+	{
+		ioctl(joyFD, JSIOCGBUTTONS, &numButtons);
+	}
 	
 	/* Allocate an array to store button information */
 	button = (struct btn *) calloc(1, sizeof( struct btn ));
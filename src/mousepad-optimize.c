@@ -0,0 +1,515 @@
+/*
+ * mousepad-optimize.c
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "layout.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <X11/Xlib.h>
+#include <X11/keysym.h>
+
+#define PROGRAM_NAME "mousepad-optimize"
+
+/* Pairs of arrows, first * 8 + second, within one layer. */
+#define NPAIRS 64
+
+/* Every binding a layout can hold, layer * NPAIRS + pair. */
+#define NSLOTS (LAYOUT_LAYERS * NPAIRS)
+
+/* Default cost model, in milliseconds. */
+#define DEFAULT_STEP_MS  250.0 /* Lifting a foot and putting it down. */
+#define DEFAULT_MOVE_MS  120.0 /* Carrying a foot one arrow's width. */
+#define DEFAULT_LAYER_MS 300.0 /* Holding Start or Back as well. */
+
+#define DEFAULT_ITERATIONS 2000000
+
+/* Annealing temperatures, in milliseconds per character. */
+#define TEMPERATURE_START 5.0
+#define TEMPERATURE_END   0.01
+
+/*
+ * Offline layout tuning: a corpus of text is turned into the steps that
+ *  would type it under a layout, each character costing the time to
+ *  lift and land feet plus the time to carry them between arrows.
+ *
+ * Holding the first arrow and stepping on the second types a character;
+ *  the next character with the same first arrow only needs the second
+ *  foot to step again, and any other needs both feet to lift and land,
+ *  on whichever arrows are closer to them.
+ *
+ * Only layer 0 is rearranged, since it is where the text is typed.
+ *  Layouts are searched by simulated annealing, one chain per thread,
+ *  swapping the symbols on two pairs at a time; since the cost is a sum
+ *  over bigrams, a swap is priced from the two symbols' rows alone.
+ */
+
+/* Where each arrow sits on the pad, by button index. */
+static const int arrow_x[8] = { 0, 0, 1, 2, 2, 2, 1, 0 };
+static const int arrow_y[8] = { 1, 0, 0, 0, 1, 2, 2, 2 };
+
+static double step_ms  = DEFAULT_STEP_MS;
+static double move_ms  = DEFAULT_MOVE_MS;
+static double layer_ms = DEFAULT_LAYER_MS;
+
+static layout_t layout;
+
+/* Time to go from typing one pair to typing the next. */
+static double transition[NPAIRS][NPAIRS];
+
+/*
+ * Every binding in the layout, and its slot. A keysym bound twice is
+ *  typed with whichever binding comes first, lowest layer first.
+ */
+static KeySym syms[NSLOTS];
+static int sym_slot[NSLOTS];
+static int nsyms = 0;
+
+/* Corpus statistics, normalized per character typed. */
+static int char_sym[256];   /* Symbol typed for a byte, or -1. */
+static int char_shift[256]; /* It needs Shift as well. */
+static double *bigrams;     /* bigrams[a * nsyms + b] */
+static double unigram_ms;   /* Per-character costs no layout 0 swap changes. */
+static long ntyped = 0;
+static long nskipped = 0;
+
+/* Layer 0 pairs with two different arrows: the ones that can be bound. */
+static int pairs[NPAIRS];
+static int npairs = 0;
+
+struct chain
+{
+	pthread_t thread;
+	unsigned int seed;
+	long iterations;
+	int slot[NSLOTS];       /* Slot of each symbol. */
+	int occupant[NPAIRS];   /* Symbol on each layer 0 pair, or -1. */
+	double cost;            /* ms per character of the best layout. */
+	int best_slot[NSLOTS];
+};
+
+static double arrow_distance(int a, int b)
+{
+	return hypot(arrow_x[a] - arrow_x[b], arrow_y[a] - arrow_y[b]);
+}
+
+static void optimize_transitions()
+{
+	for (int p = 0; p < NPAIRS; p++) {
+		int a = p / 8, b = p % 8;
+		for (int q = 0; q < NPAIRS; q++) {
+			int c = q / 8, d = q % 8;
+			if (c == a) {
+				transition[p][q] = step_ms + move_ms * arrow_distance(b, d);
+			} else {
+				double straight = arrow_distance(a, c) + arrow_distance(b, d);
+				double crossed  = arrow_distance(a, d) + arrow_distance(b, c);
+				transition[p][q] = 2 * step_ms +
+				                   move_ms * fmin(straight, crossed);
+			}
+		}
+	}
+}
+
+/* List the layout's symbols, and which symbol each byte types. */
+static void optimize_index()
+{
+	for (int layer = 0; layer < LAYOUT_LAYERS; layer++) {
+		for (int p = 0; p < NPAIRS; p++) {
+			if (layout.keys[layer][p / 8][p % 8] == NoSymbol)
+				continue;
+			syms[nsyms] = layout.keys[layer][p / 8][p % 8];
+			sym_slot[nsyms++] = layer * NPAIRS + p;
+		}
+	}
+
+	for (int p = 0; p < NPAIRS; p++)
+		if (p / 8 != p % 8)
+			pairs[npairs++] = p;
+
+	for (int c = 0; c < 256; c++) {
+		KeySym k = NoSymbol;
+
+		char_sym[c] = -1;
+		char_shift[c] = 0;
+
+		if (c == '\n')
+			k = XK_Return;
+		else if (c == '\t')
+			k = XK_Tab;
+		else if (c >= ' ' && c <= '~')
+			k = c;
+
+		for (int i = 0; k != NoSymbol && char_sym[c] < 0 && i < nsyms; i++)
+			if (syms[i] == k)
+				char_sym[c] = i;
+	}
+
+	/* Capitals are typed as small letters with Shift latched. */
+	for (int c = 'A'; c <= 'Z'; c++) {
+		if (char_sym[c] < 0) {
+			char_sym[c] = char_sym[tolower(c)];
+			char_shift[c] = 1;
+		}
+	}
+}
+
+static double optimize_char_ms(int c)
+{
+	int sym = char_sym[c];
+	return (sym_slot[sym] >= NPAIRS ? layer_ms : 0) +
+	       (char_shift[c] ? 2 * step_ms : 0);
+}
+
+/* Count a corpus file's characters and bigrams. */
+static int optimize_read(const char *path)
+{
+	static int previous = -1;
+	FILE *f = stdin;
+	int c;
+
+	if (strcmp(path, "-") && (f = fopen(path, "r")) == NULL) {
+		fprintf(stderr, PROGRAM_NAME": Could not open %s.\n", path);
+		return -1;
+	}
+
+	while ((c = getc(f)) != EOF) {
+		int sym = char_sym[c];
+		if (sym < 0) {
+			nskipped++;
+			continue;
+		}
+		ntyped++;
+		unigram_ms += optimize_char_ms(c);
+		if (previous >= 0)
+			bigrams[previous * nsyms + sym]++;
+		previous = sym;
+	}
+
+	if (f != stdin)
+		fclose(f);
+	return 0;
+}
+
+/* Describe the steps that type one character after another. */
+static void optimize_trace_char(int c, int previous)
+{
+	int slot = sym_slot[char_sym[c]];
+	int p = slot % NPAIRS;
+	double ms = 2 * step_ms;
+
+	if (isprint(c))
+		fprintf(stdout, "'%c'\t", c);
+	else
+		fprintf(stdout, "0x%02x\t", c);
+
+	if (char_shift[c])
+		fprintf(stdout, "shift ");
+	if (slot >= NPAIRS)
+		fprintf(stdout, "layer %d ", slot / NPAIRS);
+
+	if (previous >= 0) {
+		int q = sym_slot[char_sym[previous]] % NPAIRS;
+		ms = transition[q][p];
+		if (q / 8 == p / 8) {
+			fprintf(stdout, "+%s", layout_button_name(1 << (p % 8)));
+			goto done;
+		}
+	}
+	fprintf(stdout, "%s %s", layout_button_name(1 << (p / 8)),
+	        layout_button_name(1 << (p % 8)));
+
+done:
+	fprintf(stdout, "\t%.0f ms\n", ms + optimize_char_ms(c));
+}
+
+/* Print the steps for every character of a corpus file. */
+static int optimize_trace(const char *path)
+{
+	int previous = -1;
+	FILE *f = stdin;
+	int c;
+
+	if (strcmp(path, "-") && (f = fopen(path, "r")) == NULL) {
+		fprintf(stderr, PROGRAM_NAME": Could not open %s.\n", path);
+		return -1;
+	}
+
+	while ((c = getc(f)) != EOF) {
+		if (char_sym[c] < 0) {
+			fprintf(stdout, "0x%02x\tnot in layout\n", c);
+			continue;
+		}
+		optimize_trace_char(c, previous);
+		previous = c;
+	}
+
+	if (f != stdin)
+		fclose(f);
+	return 0;
+}
+
+/* Expected ms per character, for symbols bound to the given slots. */
+static double optimize_cost(const int *slot)
+{
+	double ms = unigram_ms;
+
+	for (int a = 0; a < nsyms; a++)
+		for (int b = 0; b < nsyms; b++)
+			ms += bigrams[a * nsyms + b] *
+			      transition[slot[a] % NPAIRS][slot[b] % NPAIRS];
+
+	return ms;
+}
+
+/* The part of the cost that depends on where s and t are bound. */
+static double optimize_rows(const int *slot, int s, int t)
+{
+	double ms = 0;
+
+	for (int i = 0; i < 2; i++) {
+		int a = i ? t : s;
+		if (a < 0)
+			continue;
+		int pa = slot[a] % NPAIRS;
+		for (int b = 0; b < nsyms; b++) {
+			int pb = slot[b] % NPAIRS;
+			ms += bigrams[a * nsyms + b] * transition[pa][pb];
+			if (b != s && b != t)
+				ms += bigrams[b * nsyms + a] * transition[pb][pa];
+		}
+	}
+
+	return ms;
+}
+
+static void *optimize_chain(void *arg)
+{
+	struct chain *c = arg;
+	double cost = c->cost;
+	double cooling = pow(TEMPERATURE_END / TEMPERATURE_START,
+	                     1.0 / c->iterations);
+	double temperature = TEMPERATURE_START;
+
+	for (long i = 0; i < c->iterations; i++, temperature *= cooling) {
+		int p = pairs[rand_r(&c->seed) % npairs];
+		int q = pairs[rand_r(&c->seed) % npairs];
+		int s = c->occupant[p], t = c->occupant[q];
+
+		if (p == q || (s < 0 && t < 0))
+			continue;
+
+		double delta = -optimize_rows(c->slot, s, t);
+		if (s >= 0) c->slot[s] = q;
+		if (t >= 0) c->slot[t] = p;
+		delta += optimize_rows(c->slot, s, t);
+
+		if (delta <= 0 ||
+		    rand_r(&c->seed) < RAND_MAX * exp(-delta / temperature)) {
+			c->occupant[p] = t;
+			c->occupant[q] = s;
+			cost += delta;
+			if (cost < c->cost) {
+				c->cost = cost;
+				memcpy(c->best_slot, c->slot, sizeof(c->best_slot));
+			}
+		} else {
+			if (s >= 0) c->slot[s] = p;
+			if (t >= 0) c->slot[t] = q;
+		}
+	}
+
+	return NULL;
+}
+
+static void optimize_report(const char *name, double ms)
+{
+	fprintf(stderr, " %s layout: %.1f ms per character, %.1f WPM.\n",
+	        name, ms, 60000.0 / (5 * ms));
+}
+
+int main (int argc, char *argv[])
+{
+	const char *layout_path = NULL;
+	int nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	long iterations = DEFAULT_ITERATIONS;
+	int trace = 0;
+	int first_corpus = argc;
+	FILE *f;
+
+	/* Handle arguments manually without getopt(). */
+	for (int i = 1; i < argc; i++) {
+		const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+		if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+			fprintf(stdout, "Usage: %s [options] [corpus...]\n"
+			                "  -l FILE  Layout to start from (default: "
+			                "the built-in one)\n"
+			                "  -t       Print the steps for each character "
+			                "instead of optimizing\n"
+			                "  -j N     Annealing threads (default: one "
+			                "per core)\n"
+			                "  -i N     Iterations per thread (default: "
+			                "%d)\n"
+			                "  -s MS    Time to take a step (default: "
+			                "%.0f)\n"
+			                "  -m MS    Time to carry a foot one arrow "
+			                "(default: %.0f)\n"
+			                "  -L MS    Time to hold Start or Back "
+			                "(default: %.0f)\n"
+			                "The corpus is read from standard input if no "
+			                "file is given.\n"
+			                "The optimized layout is written to standard "
+			                "output.\n", argv[0], DEFAULT_ITERATIONS,
+			                DEFAULT_STEP_MS, DEFAULT_MOVE_MS,
+			                DEFAULT_LAYER_MS);
+			return 0;
+		} else if (!strcmp(argv[i], "-t")) {
+			trace = 1;
+		} else if (argv[i][0] == '-' && argv[i][1] != '\0' &&
+		           argv[i][2] == '\0' && strchr("ljismL", argv[i][1])) {
+			if (value == NULL) {
+				fprintf(stderr, PROGRAM_NAME": %s needs a value.\n", argv[i]);
+				return 1;
+			}
+			switch (argv[i][1]) {
+				case 'l': layout_path = value; break;
+				case 'j': nthreads = atoi(value); break;
+				case 'i': iterations = atol(value); break;
+				case 's': step_ms = atof(value); break;
+				case 'm': move_ms = atof(value); break;
+				case 'L': layer_ms = atof(value); break;
+			}
+			i++;
+		} else {
+			first_corpus = i;
+			break;
+		}
+	}
+
+	if (nthreads < 1)
+		nthreads = 1;
+
+	if (layout_path == NULL) {
+		layout_default(&layout);
+	} else if ((f = fopen(layout_path, "r")) == NULL) {
+		fprintf(stderr, PROGRAM_NAME": Could not open %s.\n", layout_path);
+		return 1;
+	} else {
+		int error = layout_read(f, &layout);
+		fclose(f);
+		if (error < 0)
+			return 1;
+	}
+
+	optimize_transitions();
+	optimize_index();
+
+	if (trace) {
+		if (first_corpus == argc)
+			return optimize_trace("-") < 0;
+		for (int i = first_corpus; i < argc; i++)
+			if (optimize_trace(argv[i]) < 0)
+				return 1;
+		return 0;
+	}
+
+	bigrams = calloc(nsyms * nsyms, sizeof(double));
+	if (bigrams == NULL) {
+		fprintf(stderr, PROGRAM_NAME": Out of memory.\n");
+		return 1;
+	}
+
+	if (first_corpus == argc && optimize_read("-") < 0)
+		return 1;
+	for (int i = first_corpus; i < argc; i++)
+		if (optimize_read(argv[i]) < 0)
+			return 1;
+
+	if (ntyped < 2) {
+		fprintf(stderr, PROGRAM_NAME": The corpus is too short.\n");
+		return 1;
+	}
+
+	/* The first character still needs both feet to land. */
+	unigram_ms = (unigram_ms + 2 * step_ms) / ntyped;
+	for (int i = 0; i < nsyms * nsyms; i++)
+		bigrams[i] /= ntyped;
+
+	double start = optimize_cost(sym_slot);
+	fprintf(stderr, " %ld characters read, %ld not in the layout.\n",
+	        ntyped, nskipped);
+	optimize_report("Current", start);
+
+	/* Every chain starts from the given layout. */
+	struct chain *chains = calloc(nthreads, sizeof(struct chain));
+	if (chains == NULL) {
+		fprintf(stderr, PROGRAM_NAME": Out of memory.\n");
+		return 1;
+	}
+
+	for (int i = 0; i < nthreads; i++) {
+		struct chain *c = &chains[i];
+
+		c->seed = time(NULL) + i * 7919;
+		c->iterations = iterations;
+		c->cost = start;
+		memcpy(c->slot, sym_slot, sizeof(c->slot));
+		memcpy(c->best_slot, sym_slot, sizeof(c->best_slot));
+		memset(c->occupant, 0xff, sizeof(c->occupant));
+		for (int s = 0; s < nsyms; s++)
+			if (sym_slot[s] < NPAIRS)
+				c->occupant[sym_slot[s]] = s;
+
+		if (pthread_create(&c->thread, NULL, optimize_chain, c)) {
+			fprintf(stderr, PROGRAM_NAME": Could not start a thread.\n");
+			return 1;
+		}
+	}
+
+	struct chain *best = &chains[0];
+	for (int i = 0; i < nthreads; i++) {
+		pthread_join(chains[i].thread, NULL);
+		if (chains[i].cost < best->cost)
+			best = &chains[i];
+	}
+
+	/* Rebind layer 0 as the best chain left it. */
+	memset(layout.keys[0], 0x0, sizeof(layout.keys[0]));
+	for (int s = 0; s < nsyms; s++) {
+		int slot = best->best_slot[s];
+		if (slot < NPAIRS)
+			layout.keys[0][slot / 8][slot % 8] = syms[s];
+	}
+
+	/* Price the result from scratch, rather than from the running sums. */
+	double end = optimize_cost(best->best_slot);
+	optimize_report("Optimized", end);
+
+	fprintf(stdout, "# Written by "PROGRAM_NAME" (%.1f WPM predicted).\n",
+	        60000.0 / (5 * end));
+	return layout_write(stdout, &layout) < 0;
+}
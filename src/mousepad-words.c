@@ -0,0 +1,318 @@
+/*
+ * mousepad-words.c
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "complete.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PROGRAM_NAME "mousepad-words"
+
+/*
+ * Builds the trie that word completion maps and searches in place,
+ *  from word lists of one word per line, optionally followed by a count
+ *  of how common it is. '#' begins a comment. Words that mousepad would
+ *  not follow as they are typed, with anything but letters and
+ *  apostrophes in them, are left out; the rest are folded to lower
+ *  case, and the counts of repeated words added up.
+ *
+ * The trie is built with a list of children at each node, then written
+ *  out breadth first, so that the children of each node are consecutive.
+ */
+
+struct node
+{
+	int child, last, sibling; /* Node indices, or -1. */
+	int nchildren;
+	int word;                 /* The word ending here, or -1. */
+	int top[COMPLETE_TOP];    /* Most common words below, or -1. */
+	int index;                /* Where it is written. */
+	char c;
+};
+
+struct word
+{
+	char *text;
+	unsigned count;
+};
+
+static struct node *nodes;
+static int nnodes, cap_nodes;
+static struct word *words;
+static int nwords, cap_words;
+
+/* Make room for element n of a growable array, or exit. */
+static void *words_grow(void *array, int *cap, int n, size_t size)
+{
+	if (n < *cap)
+		return array;
+
+	*cap = *cap ? *cap * 2 : 1024;
+	array = realloc(array, *cap * size);
+	if (array == NULL) {
+		fprintf(stderr, PROGRAM_NAME": Out of memory.\n");
+		exit(1);
+	}
+	return array;
+}
+
+static int words_by_text(const void *a, const void *b)
+{
+	return strcmp(((const struct word *)a)->text, ((const struct word *)b)->text);
+}
+
+/* Read one word list, adding its words to the end of words. */
+static int words_read(const char *path)
+{
+	char line[256], buf[COMPLETE_MAX_WORD + 1];
+	FILE *f = stdin;
+
+	if (strcmp(path, "-") && (f = fopen(path, "r")) == NULL) {
+		fprintf(stderr, PROGRAM_NAME": Could not open %s.\n", path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		char *p = line;
+		int len = 0;
+
+		while (isspace((unsigned char)*p))
+			p++;
+		for (; *p && !isspace((unsigned char)*p) && *p != '#'; p++) {
+			if ((!isalpha((unsigned char)*p) && *p != '\'') ||
+			    len == COMPLETE_MAX_WORD)
+				break;
+			buf[len++] = tolower((unsigned char)*p);
+		}
+		buf[len] = '\0';
+		if (len == 0 || (*p && !isspace((unsigned char)*p) && *p != '#'))
+			continue;
+
+		unsigned count = 1;
+		while (*p == ' ' || *p == '\t')
+			p++;
+		if (isdigit((unsigned char)*p))
+			count = strtoul(p, NULL, 10);
+
+		words = words_grow(words, &cap_words, nwords, sizeof(struct word));
+		words[nwords].text = strdup(buf);
+		words[nwords].count = count;
+		if (words[nwords].text == NULL) {
+			fprintf(stderr, PROGRAM_NAME": Out of memory.\n");
+			exit(1);
+		}
+		nwords++;
+	}
+
+	if (f != stdin)
+		fclose(f);
+	return 0;
+}
+
+/* Sort the words, and merge repeated ones. */
+static void words_merge()
+{
+	int n = 0;
+
+	qsort(words, nwords, sizeof(struct word), words_by_text);
+	for (int i = 0; i < nwords; i++) {
+		if (n && !strcmp(words[n - 1].text, words[i].text)) {
+			words[n - 1].count += words[i].count;
+			free(words[i].text);
+		} else {
+			words[n++] = words[i];
+		}
+	}
+	nwords = n;
+}
+
+static int node_new(char c)
+{
+	nodes = words_grow(nodes, &cap_nodes, nnodes, sizeof(struct node));
+
+	struct node *n = &nodes[nnodes];
+	n->child = n->last = n->sibling = -1;
+	n->nchildren = 0;
+	n->word = -1;
+	n->c = c;
+	for (int i = 0; i < COMPLETE_TOP; i++)
+		n->top[i] = -1;
+	return nnodes++;
+}
+
+/*
+ * Returns the child of node n for c, adding it if needed.
+ * Words arrive in order, so a new child always goes last.
+ */
+static int node_child(int n, char c)
+{
+	int last = nodes[n].last;
+
+	if (last >= 0 && nodes[last].c == c)
+		return last;
+
+	int i = node_new(c);
+	if (last >= 0)
+		nodes[last].sibling = i;
+	else
+		nodes[n].child = i;
+	nodes[n].last = i;
+	nodes[n].nchildren++;
+	return i;
+}
+
+/* Returns nonzero if word a is more common than b, or as common and earlier. */
+static int words_better(int a, int b)
+{
+	return words[a].count > words[b].count ||
+	       (words[a].count == words[b].count && a < b);
+}
+
+/* Offer word w to node n's list of most common words. */
+static void node_offer(int n, int w)
+{
+	int *top = nodes[n].top;
+	int i = COMPLETE_TOP;
+
+	while (i > 0 && (top[i - 1] < 0 || words_better(w, top[i - 1])))
+		i--;
+	if (i == COMPLETE_TOP)
+		return;
+
+	memmove(&top[i + 1], &top[i], (COMPLETE_TOP - 1 - i) * sizeof(int));
+	top[i] = w;
+}
+
+/* Fill in the most common words below node n, and below its children. */
+static void node_rank(int n)
+{
+	if (nodes[n].word >= 0)
+		node_offer(n, nodes[n].word);
+
+	for (int c = nodes[n].child; c >= 0; c = nodes[c].sibling) {
+		node_rank(c);
+		for (int i = 0; i < COMPLETE_TOP && nodes[c].top[i] >= 0; i++)
+			node_offer(n, nodes[c].top[i]);
+	}
+}
+
+static int words_write(FILE *f)
+{
+	struct complete_trie_header h;
+	uint32_t ntext = 0;
+	int *order = malloc(nnodes * sizeof(int));
+
+	if (order == NULL) {
+		fprintf(stderr, PROGRAM_NAME": Out of memory.\n");
+		return -1;
+	}
+
+	/* Breadth first: each node's children are queued together. */
+	int head = 0, tail = 0;
+	order[tail++] = 0;
+	while (head < tail) {
+		int n = order[head];
+		nodes[n].index = head++;
+		for (int c = nodes[n].child; c >= 0; c = nodes[c].sibling)
+			order[tail++] = c;
+	}
+
+	for (int i = 0; i < nwords; i++)
+		ntext += strlen(words[i].text) + 1;
+
+	memset(&h, 0x0, sizeof(h));
+	memcpy(h.magic, COMPLETE_TRIE_MAGIC, sizeof(h.magic));
+	h.nnodes = nnodes;
+	h.nwords = nwords;
+	h.ntext = ntext;
+	fwrite(&h, sizeof(h), 1, f);
+
+	for (int i = 0; i < nnodes; i++) {
+		const struct node *n = &nodes[order[i]];
+		struct complete_trie_node t;
+
+		memset(&t, 0x0, sizeof(t));
+		t.child = (n->child >= 0) ? nodes[n->child].index : 0;
+		t.nchildren = n->nchildren;
+		t.c = n->c;
+		t.word = n->word;
+		memcpy(t.top, n->top, sizeof(t.top));
+		fwrite(&t, sizeof(t), 1, f);
+	}
+
+	ntext = 0;
+	for (int i = 0; i < nwords; i++) {
+		struct complete_trie_word t = { ntext, words[i].count };
+		fwrite(&t, sizeof(t), 1, f);
+		ntext += strlen(words[i].text) + 1;
+	}
+
+	for (int i = 0; i < nwords; i++)
+		fwrite(words[i].text, strlen(words[i].text) + 1, 1, f);
+
+	free(order);
+	if (fflush(f) != 0 || ferror(f)) {
+		fprintf(stderr, PROGRAM_NAME": Could not write the trie.\n");
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int first_list = 1;
+
+	if (argc > 1 && (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help"))) {
+		fprintf(stdout, "Usage: %s [word list ...] > ~/.%s\n"
+		                "Each line of a word list is a word, optionally "
+		                "followed by how common it is.\n"
+		                "The lists are read from standard input if none "
+		                "is given.\n"
+		                "The trie is written to standard output.\n",
+		        argv[0], COMPLETE_TRIE_FILENAME);
+		return 0;
+	}
+
+	if (first_list == argc && words_read("-") < 0)
+		return 1;
+	for (int i = first_list; i < argc; i++)
+		if (words_read(argv[i]) < 0)
+			return 1;
+
+	words_merge();
+	if (nwords == 0) {
+		fprintf(stderr, PROGRAM_NAME": No words to write.\n");
+		return 1;
+	}
+
+	node_new(0);
+	for (int w = 0; w < nwords; w++) {
+		int n = 0;
+		for (const char *t = words[w].text; *t; t++)
+			n = node_child(n, *t);
+		nodes[n].word = w;
+	}
+	node_rank(0);
+
+	fprintf(stderr, " %d words, %d trie nodes.\n", nwords, nnodes);
+	return words_write(stdout) < 0;
+}
@@ -21,9 +21,22 @@
 #define PROGRAM_NAME "mousepad"
 #define VERSION_NUMBER "0.3"
 
+#include "clock.h"
+#include "complete.h"
 #include "config.h"
+#include "gesture.h"
+#include "input.h"
 #include "keyboard.h"
+#include "layout.h"
+#include "magnet.h"
+#include "mode.h"
 #include "mouse.h"
+#include "output.h"
+#include "profile.h"
+#include "repeat.h"
+#include "ring.h"
+#include "snippet.h"
+#include "steno.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -32,131 +45,391 @@
 #include <string.h>
 #include <time.h>
 #include <errno.h>
+#include <stdint.h>
 
 #include <gtk/gtk.h>
 
 #include <X11/X.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
-#include <X11/extensions/XTest.h>
 
-#include <fcntl.h>
-#include <sys/ioctl.h>
-#include <linux/joystick.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
 
-#define MODE_MOUSE 0
-#define MODE_KEYBOARD 1
+/* How often to look for the pad again after it is unplugged. */
+#define RECONNECT_SECONDS 1
+
+#define MOUSE_TICK_NSEC (MOUSE_DELAY_MILLISECONDS * NSEC_PER_MSEC)
+
+/* Handle everything the X server has sent on our Xlib connection. */
+static void x_events(Display *display)
+{
+	XEvent xev;
+
+	while (XPending(display)) {
+		XNextEvent(display, &xev);
+
+		switch (xev.type) {
+			case MappingNotify:
+				XRefreshKeyboardMapping(&xev.xmapping);
+				if (xev.xmapping.request != MappingPointer)
+					keyboard_mapping_changed();
+				break;
+
+			case CreateNotify:
+			case ConfigureNotify:
+			case MapNotify:
+			case UnmapNotify:
+			case DestroyNotify:
+				magnet_event(&xev);
+				profile_event(&xev);
+				break;
+
+			case PropertyNotify:
+				profile_event(&xev);
+				break;
+
+			default:
+				break;
+		}
+	}
+}
+
+/*
+ * Read in the configuration file, mapping each of n button numbers
+ *  to a button bitfield. Returns NULL after reporting any error.
+ */
+static int *joymap_load(int n)
+{
+	FILE *configfile = config_open();
+	if (configfile == NULL) {
+		fprintf(stderr, " Couldn't find a pad configuration file.\n"
+		                " Run "PROGRAM_NAME"-config to build one.\n");
+		return NULL;
+	}
+
+	int *joymap = calloc(n, sizeof(int));
+	if (joymap == NULL || config_read(configfile, n, joymap) < 0) {
+		fprintf(stderr, " Error parsing configuration file.\n");
+		config_close(configfile);
+		free(joymap);
+		return NULL;
+	}
+
+	config_close(configfile);
+	return joymap;
+}
+
+/* Let GTK handle its events and redraw the overlays, without blocking. */
+static void gtk_pump()
+{
+	while (gtk_events_pending())
+		gtk_main_iteration_do(FALSE);
+	gdk_display_flush(gdk_display_get_default());
+}
+
+/* Arms the timer for an absolute monotonic deadline, or disarms it on 0. */
+static int timer_arm(int fd, long long deadline)
+{
+	struct itimerspec its;
+	memset(&its, 0x0, sizeof(struct itimerspec));
+	its.it_value = clock_timespec(deadline);
+	return timerfd_settime(fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/* Fires every period seconds until disarmed with a period of 0. */
+static int retry_arm(int fd, int period)
+{
+	struct itimerspec its;
+	memset(&its, 0x0, sizeof(struct itimerspec));
+	its.it_value.tv_sec = period;
+	its.it_interval.tv_sec = period;
+	return timerfd_settime(fd, 0, &its, NULL);
+}
 
 int main (int argc, char *argv[])
 {
-	int mode = MODE_MOUSE;
 	char *device = "/dev/input/js0";
-	int joyfd;
-	struct js_event jevent;
-	int njoybtn;
+	int device_set = 0;
+	int grab = 0;
+	int verbose = 0;
+	int njoybtn, n;
+	ring_t ring;
 	FILE *configfile;
+	FILE *layoutfile;
+	static layout_t layout;
 	
 	gtk_init(&argc, &argv);
 	
-	if (argc > 2) {
-		fprintf(stderr, PROGRAM_NAME": Too many arguments.\n"); 
-		return 1;
-	}
-
-	if (argc == 2) {
-		if (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help")) {
-			fprintf(stdout, "Usage: %s [Joystick Device]\n", argv[0]);
+	/* Handle arguments manually without getopt(). */
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+			fprintf(stdout, "Usage: %s [-g] [-v] [Joystick Device]\n"
+			                "  -g, --grab     Keep other programs from seeing "
+			                "the pad (event devices only)\n"
+			                "  -v, --verbose  Report how often output is "
+			                "flushed\n", argv[0]);
 			return 0;
+		} else if (!strcmp(argv[i], "-g") || !strcmp(argv[i], "--grab")) {
+			grab = 1;
+		} else if (!strcmp(argv[i], "-v") || !strcmp(argv[i], "--verbose")) {
+			verbose = 1;
+		} else if (!device_set) {
+			device = argv[i];
+			device_set = 1;
 		} else {
-			device = argv[1];
+			fprintf(stderr, PROGRAM_NAME": Too many arguments.\n"); 
+			return 1;
 		}
 	}
 
 
 	/* Initialize joystick. */
-	// TODO: Make this blocking and have a separate thread for cursor.
-	if ((joyfd = open(device, O_RDONLY | O_NONBLOCK)) < 0) {
+	if ((njoybtn = input_open(device, grab)) < 0) {
 		fprintf(stderr, " Could not open joystick device.\n");
 		return 1;
 	}
-		
-	/* Retrieve the number of buttons */
-	ioctl(joyfd, JSIOCGBUTTONS, &njoybtn);
-	if (njoybtn <= 0)
-		return 1;
 
-	/* Map from jevent.number to button bitfield. */
-	int *joymap = malloc(njoybtn * sizeof(int));
+	/* Map from button number to button bitfield. */
+	int *joymap = joymap_load(njoybtn);
+	if (joymap == NULL)
+		return 1;
 
+	/* Read in settings, if there are any. */
+	configfile = config_settings_open();
+	if (configfile != NULL) {
+		if (config_settings_read(configfile) < 0) {
+			fprintf(stderr, " Error parsing settings file.\n");
+			return 1;
+		}
+		config_close(configfile);
+	}
+	gesture_init();
+	repeat_init();
+	mode_init();
 
-	/* Read in configuration file */
-	configfile = config_open();
-	if (configfile == NULL) {
-		fprintf(stderr, " Couldn't find a pad configuration file.\n"
-		                " Run "PROGRAM_NAME"-config to build one.\n");
+	/* Read in keyboard layout, if there is one. */
+	layoutfile = layout_open();
+	if (layoutfile == NULL) {
+		layout_default(&layout);
+	} else if (layout_read(layoutfile, &layout) < 0) {
+		fprintf(stderr, " Error parsing layout file.\n");
 		return 1;
 	}
+	layout_close(layoutfile);
 
-	if (config_read(configfile, njoybtn, joymap) < 0) {
-		fprintf(stderr, " Error parsing configuration file.\n");
+	/* The dictionary is only needed, and only checked, if steno is on. */
+	if (mode_enabled(MODE_STENO) && steno_init() < 0) {
+		fprintf(stderr, " Error parsing steno dictionary.\n");
+		return 1;
+	}
+	if (snippet_init() < 0) {
+		fprintf(stderr, " Error parsing snippets file.\n");
+		return 1;
+	}
+	if (complete_init() < 0) {
+		fprintf(stderr, " Could not start keeping learned words.\n");
 		return 1;
 	}
-	config_close(configfile);
 	
 
 	/* Initialize event handlers. */
+	if (output_init(verbose) < 0) {
+		fprintf(stderr, " Could not connect to the X server for input injection.\n");
+		return 1;
+	}
+
 	Display *display = XOpenDisplay(NULL);
 	if (mouse_init(display) < 0) return 1;
 	if (keyboard_init(display) < 0) return 1;
+	keyboard_set_layout(&layout, layoutfile == NULL);
+	if (profile_init(display, &layout, layoutfile == NULL) < 0) {
+		fprintf(stderr, " Could not follow the active window.\n");
+		return 1;
+	}
 	
 
+	/*
+	 * Initialize the event loop.
+	 * Pad input is read on its own thread and handed over through the ring;
+	 *  this thread sleeps until the ring has events or a tick is due.
+	 * The timer is only armed while the cursor is accelerating,
+	 *  a gesture is waiting to be decided, or an action is repeating.
+	 * While the pad is unplugged, a second timer retries opening it,
+	 *  and X and GTK events are still handled in the meantime.
+	 */
+	int epfd = epoll_create1(0);
+	int timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+	int retryfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+	if (epfd < 0 || timerfd < 0 || retryfd < 0 || ring_init(&ring) < 0) {
+		fprintf(stderr, " Could not create event loop.\n");
+		return 1;
+	}
+
+	struct epoll_event ev;
+	memset(&ev, 0x0, sizeof(struct epoll_event));
+	ev.events = EPOLLIN;
+	ev.data.fd = ring_fd(&ring);
+	epoll_ctl(epfd, EPOLL_CTL_ADD, ring_fd(&ring), &ev);
+	ev.data.fd = timerfd;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, timerfd, &ev);
+	ev.data.fd = retryfd;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, retryfd, &ev);
+	ev.data.fd = ConnectionNumber(display);
+	epoll_ctl(epfd, EPOLL_CTL_ADD, ConnectionNumber(display), &ev);
+	int gdkfd = ConnectionNumber(GDK_DISPLAY_XDISPLAY(gdk_display_get_default()));
+	ev.data.fd = gdkfd;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, gdkfd, &ev);
+
+	if (input_start(&ring, joymap) < 0) {
+		fprintf(stderr, " Could not start input thread.\n");
+		return 1;
+	}
+
+	int buttons = 0;
+	long long deadline = 0; /* Time the timer is armed for, or 0. */
+	long long tick = 0;     /* Next mode_tick(), or 0 if not moving. */
+	int connected = 1;
+
+	mode_switch(MODE_MOUSE);
+	gtk_pump();
+
+	/* Main loop */
 	while (1) {
-		mouse_begin();
-		int buttons = 0;
-
-		/* Main loop */
-		while (1) {
-			/* Update button values */
-			read(joyfd, &jevent, sizeof(struct js_event));
-			if (errno == ENODEV)
-				return 1;
-
-			int changed = 0;
-			if ((jevent.type & ~JS_EVENT_INIT) == JS_EVENT_BUTTON) {
-				/* If the button has changed value */
-				if (((buttons | joymap[jevent.number]) == 0) == (jevent.value == 0)) {
-					changed = joymap[jevent.number];
-					if (jevent.value)
-						buttons |= changed;
-					else
-						buttons &= ~changed;
+		struct epoll_event ready[5];
+		int disconnected = 0;
+
+		int nready = epoll_wait(epfd, ready, 5, -1);
+		if (nready < 0 && errno != EINTR)
+			return 1;
+
+		/* Whatever this frame injects is flushed once, at its end. */
+		output_batch_begin();
+
+		for (int i = 0; i < nready; i++) {
+			if (ready[i].data.fd == timerfd) {
+				uint64_t expirations;
+				long long now = clock_nsec();
+				read(timerfd, &expirations, sizeof(uint64_t));
+				deadline = 0;
+				if (!connected)
+					continue;
+				if (tick && now >= tick) {
+					mode_tick(now);
+					tick += MOUSE_TICK_NSEC;
+					if (tick <= now)
+						tick = now + MOUSE_TICK_NSEC;
+				}
+				gesture_tick(now);
+				repeat_tick(now);
+				continue;
+			}
+
+			/* Look for the pad again, with the same mapping. */
+			if (ready[i].data.fd == retryfd) {
+				uint64_t expirations;
+				read(retryfd, &expirations, sizeof(uint64_t));
+				if (connected || (n = input_open(device, grab)) < 0)
+					continue;
+
+				if (n != njoybtn) {
+					free(joymap);
+					njoybtn = n;
+					if ((joymap = joymap_load(njoybtn)) == NULL)
+						return 1;
+				}
+
+				if (input_start(&ring, joymap) < 0) {
+					fprintf(stderr, " Could not start input thread.\n");
+					return 1;
 				}
+
+				retry_arm(retryfd, 0);
+				connected = 1;
+				buttons = 0;
+				mode_switch(MODE_MOUSE);
+				continue;
 			}
 
-			/* Process Events */
-			if (mode == MODE_MOUSE) {
-				if (changed)
-					mouse_event(buttons, changed);
-				mouse_tick();
-			} else if (mode == MODE_KEYBOARD) {
-				if (changed)
-					keyboard_event(buttons, changed);
+			if (ready[i].data.fd == ConnectionNumber(display)) {
+				x_events(display);
+				continue;
 			}
 
-			/* Powernap */
-			usleep(5000);
+			/* GTK events are handled by gtk_pump() below. */
+			if (ready[i].data.fd == gdkfd)
+				continue;
+
+			/* Update button values from every queued event. */
+			struct padevent e;
+			ring_clear(&ring);
+			while (connected && ring_pop(&ring, &e)) {
+				if (e.type == PADEVENT_DISCONNECT) {
+					disconnected = 1;
+					break;
+				}
+
+				if (e.type == PADEVENT_AXIS) {
+					mode_axis(e.axis, e.value);
+					continue;
+				}
+
+				/* If the button has changed value */
+				int changed = e.button;
+				if (((buttons & changed) == 0) == (e.value == 0))
+					continue;
+
+				if (e.value)
+					buttons |= changed;
+				else
+					buttons &= ~changed;
+
+				/* Process Events */
+				gesture_event(buttons, changed, e.time);
+				repeat_event(buttons);
+			}
+		}
+
+		/* Round-trips may have left X events queued inside Xlib. */
+		if (XEventsQueued(display, QueuedAlready))
+			x_events(display);
+
+		/* Joystick disconnected: wait for it to return. */
+		if (disconnected) {
+			input_close();
+			mode_end();
+			connected = 0;
+			tick = 0;
+			fprintf(stderr, " Joystick disconnected; waiting for it to return.\n");
+			retry_arm(retryfd, RECONNECT_SECONDS);
+		}
+
+		output_batch_end();
+
+		/* Draw whatever the overlays were asked to show. */
+		gtk_pump();
+
+		/* Keep a tick scheduled only while the cursor is in motion. */
+		if (connected && mode_moving()) {
+			if (!tick)
+				tick = clock_nsec() + MOUSE_TICK_NSEC;
+		} else {
+			tick = 0;
+		}
+
+		/* Wake for whichever of the tick and the gestures comes first. */
+		long long next = tick;
+		long long when;
+		if (connected && gesture_deadline(&when) && (!next || when < next))
+			next = when;
+		if (connected && repeat_deadline(&when) && (!next || when < next))
+			next = when;
+		if (next != deadline) {
+			deadline = next;
+			timer_arm(timerfd, deadline);
 		}
-	
-		/* Joystick disconnected */
-		close(joyfd);
-	
-		/* Reset default modes */
-		mouse_end();
-		mode = 0;
-		// TODO: keyboard_begin();
 	}
 	
 	free(joymap);
 	return 0;
 }
-
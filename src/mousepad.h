@@ -37,11 +37,21 @@
 #define BUTTON_START     (0x1 << 8)
 #define BUTTON_BACK      (0x1 << 9)
 
+/* Number of pad buttons, and the eight directional ones among them. */
+#define NBUTTONS      10
+#define BUTTON_ARROWS 0xff
+
 /* Bitfield of pad button toggles, using the above defines. */
 typedef int buttonstate_t;
 
 /* Bitfield of pad button toggles, but only one bit is set. */
 typedef int button_t;
 
+/* Position of a button's bit, from 0 to NBUTTONS - 1, for indexing tables. */
+static inline int button_index(button_t button)
+{
+	return __builtin_ctz(button);
+}
+
 #endif /* __mousepad_mousepad_h__ */
 
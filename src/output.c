@@ -0,0 +1,414 @@
+/*
+ * output.c
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "output.h"
+#include "clock.h"
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h>
+#include <xcb/xtest.h>
+
+/*
+ * All injected input goes through this module, on its own XCB connection.
+ * Callers append to a bounded queue and return immediately; a writer thread
+ *  drains the queue, pipelines the XTest requests without waiting on each,
+ *  and flushes once per batch. Errors arrive later as events and are
+ *  only reported, never waited for.
+ *
+ * Every batch is followed by a cheap GetInputFocus request. If the server
+ *  has not answered OUTPUT_MAX_INFLIGHT of those, it has fallen behind,
+ *  and the writer stops sending until it catches up. Meanwhile the queue
+ *  keeps absorbing input: consecutive motion deltas are merged into one,
+ *  a warp replaces the motion before it, and button and key events are
+ *  always kept, in order.
+ *
+ * Between output_batch_begin() and output_batch_end(), the writer leaves
+ *  the queue alone unless it fills up, so a burst of events, such as a
+ *  whole word, goes out as one batch with one flush. The main loop opens
+ *  a batch around each frame of input it handles, so everything a frame
+ *  causes is flushed once, when the frame is done. A batch held open for
+ *  longer than the maximum latency is sent anyway.
+ */
+
+/* Not an event to fake: rebind a key code, in order with the events. */
+#define OUTPUT_REMAP 0
+
+struct output_event
+{
+	unsigned char type;   /* XCB event type to fake, or OUTPUT_REMAP. */
+	unsigned char detail; /* Key code, button, or relative flag for motion. */
+	int x, y;             /* Motion delta. */
+	unsigned keysym;      /* Keysym given to the key code by OUTPUT_REMAP. */
+};
+
+static xcb_connection_t *connection;
+static pthread_t thread;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t nonempty; /* On CLOCK_MONOTONIC; see output_init(). */
+static pthread_cond_t nonfull  = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t drained  = PTHREAD_COND_INITIALIZER;
+
+/* Everything below is protected by lock. */
+static struct output_event queue[OUTPUT_QUEUE_SIZE];
+static int head, count;
+static int busy;      /* Writer is sending a batch it took off the queue. */
+static int batching;  /* Depth of output_batch_begin() calls. */
+static long long queued_at; /* When the oldest queued event was queued. */
+
+static long long max_latency;
+
+/* Writer-private: flushes since they were last reported, if verbose. */
+static int verbose;
+static int flushes;
+static long long reported_at;
+static int want_sync; /* output_drain() is waiting on the server. */
+static int closing;
+static int broken;    /* The connection died; events are discarded. */
+
+/* Writer-private: sequence markers of unacknowledged batches. */
+static xcb_get_input_focus_cookie_t inflight[OUTPUT_MAX_INFLIGHT];
+static int ninflight;
+
+/* Report errors from earlier requests, without blocking. */
+static void output_check_errors()
+{
+	xcb_generic_event_t *ev;
+
+	while ((ev = xcb_poll_for_event(connection)) != NULL) {
+		if (ev->response_type == 0) {
+			xcb_generic_error_t *err = (xcb_generic_error_t *)ev;
+			fprintf(stderr, " X error %d on injected request %d.\n",
+			        err->error_code, err->sequence);
+		}
+		free(ev);
+	}
+}
+
+/* Wait until the server has handled the oldest unacknowledged batch. */
+static void output_retire()
+{
+	xcb_get_input_focus_reply_t *reply;
+
+	reply = xcb_get_input_focus_reply(connection, inflight[0], NULL);
+	free(reply);
+
+	ninflight--;
+	for (int i = 0; i < ninflight; i++)
+		inflight[i] = inflight[i + 1];
+}
+
+/* Forget batches the server has already answered for. */
+static void output_poll_retired()
+{
+	while (ninflight > 0) {
+		void *reply = NULL;
+		xcb_generic_error_t *err = NULL;
+
+		if (!xcb_poll_for_reply(connection, inflight[0].sequence, &reply, &err))
+			return;
+		free(reply);
+		free(err);
+
+		ninflight--;
+		for (int i = 0; i < ninflight; i++)
+			inflight[i] = inflight[i + 1];
+	}
+}
+
+static void output_send(const struct output_event *e)
+{
+	int x = e->x, y = e->y;
+
+	if (e->type == OUTPUT_REMAP) {
+		xcb_keysym_t syms[2] = { e->keysym, e->keysym };
+		xcb_change_keyboard_mapping(connection, 1, e->detail, 2, syms);
+		return;
+	}
+
+	/* Merged motion may exceed the request's 16-bit fields. */
+	if (x < -32768) x = -32768;
+	if (x > 32767)  x = 32767;
+	if (y < -32768) y = -32768;
+	if (y > 32767)  y = 32767;
+
+	xcb_test_fake_input(connection, e->type, e->detail, XCB_CURRENT_TIME,
+	                    XCB_NONE, x, y, 0);
+}
+
+/* Count a flush, and report the rate about once a second if verbose. */
+static void output_count_flush()
+{
+	long long now = clock_nsec();
+
+	if (!verbose)
+		return;
+
+	flushes++;
+	if (now - reported_at >= NSEC_PER_SEC) {
+		fprintf(stderr, " %.1f flushes per second.\n",
+		        flushes * (double)NSEC_PER_SEC / (now - reported_at));
+		flushes = 0;
+		reported_at = now;
+	}
+}
+
+static void *output_thread(void *arg)
+{
+	static struct output_event batch[OUTPUT_QUEUE_SIZE];
+
+	pthread_mutex_lock(&lock);
+	while (1) {
+		while ((count == 0 || (batching && count < OUTPUT_QUEUE_SIZE &&
+		                       clock_nsec() < queued_at + max_latency)) &&
+		       !want_sync && !closing) {
+			if (count == 0) {
+				pthread_cond_wait(&nonempty, &lock);
+			} else {
+				struct timespec t = clock_timespec(queued_at + max_latency);
+				pthread_cond_timedwait(&nonempty, &lock, &t);
+			}
+		}
+
+		if (count == 0 && closing)
+			break;
+
+		/* Nothing left to send: let output_drain() know the server is done. */
+		if (count == 0) {
+			pthread_mutex_unlock(&lock);
+			while (ninflight > 0)
+				output_retire();
+			pthread_mutex_lock(&lock);
+			want_sync = 0;
+			pthread_cond_broadcast(&drained);
+			continue;
+		}
+
+		/* Take the whole queue as one batch. */
+		int n = count;
+		for (int i = 0; i < n; i++)
+			batch[i] = queue[(head + i) % OUTPUT_QUEUE_SIZE];
+		head = (head + n) % OUTPUT_QUEUE_SIZE;
+		count = 0;
+		busy = 1;
+		pthread_cond_broadcast(&nonfull);
+		pthread_mutex_unlock(&lock);
+
+		/* Hold off while the server is behind; the queue collapses motion. */
+		output_poll_retired();
+		if (ninflight == OUTPUT_MAX_INFLIGHT)
+			output_retire();
+
+		for (int i = 0; i < n; i++)
+			output_send(&batch[i]);
+		inflight[ninflight++] = xcb_get_input_focus(connection);
+		xcb_flush(connection);
+		output_count_flush();
+
+		output_check_errors();
+
+		pthread_mutex_lock(&lock);
+		busy = 0;
+		if (xcb_connection_has_error(connection)) {
+			fprintf(stderr, " Lost the X connection used for injection.\n");
+			broken = 1;
+			count = 0;
+			pthread_cond_broadcast(&nonfull);
+			pthread_cond_broadcast(&drained);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&lock);
+
+	return NULL;
+}
+
+/*
+ * Connect to the X server and start the writer thread.
+ * If verbose is set, the rate of flushes is reported.
+ */
+int output_init(int v)
+{
+	pthread_condattr_t attr;
+
+	verbose = v;
+	reported_at = clock_nsec();
+	max_latency = config_int("output_max_latency", OUTPUT_MAX_LATENCY_MILLISECONDS)
+	              * NSEC_PER_MSEC;
+
+	/* Batches are timed on the same clock as everything else. */
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&nonempty, &attr);
+	pthread_condattr_destroy(&attr);
+
+	connection = xcb_connect(NULL, NULL);
+	if (xcb_connection_has_error(connection))
+		return -1;
+
+	const xcb_query_extension_reply_t *ext;
+	ext = xcb_get_extension_data(connection, &xcb_test_id);
+	if (ext == NULL || !ext->present) {
+		fprintf(stderr, " The X server lacks the XTEST extension.\n");
+		return -1;
+	}
+
+	if (pthread_create(&thread, NULL, output_thread, NULL) != 0)
+		return -1;
+	return 0;
+}
+
+/* Send everything still queued, then disconnect. */
+void output_close()
+{
+	pthread_mutex_lock(&lock);
+	closing = 1;
+	pthread_cond_signal(&nonempty);
+	pthread_mutex_unlock(&lock);
+
+	pthread_join(thread, NULL);
+	xcb_disconnect(connection);
+}
+
+/*
+ * Append an event to the queue, blocking only if it is full of
+ *  events that can't be merged.
+ */
+static void output_push(const struct output_event *e)
+{
+	pthread_mutex_lock(&lock);
+
+	if (broken) {
+		pthread_mutex_unlock(&lock);
+		return;
+	}
+
+	/* Relative motion merges into relative motion still waiting to go out. */
+	if (count > 0 && e->type == XCB_MOTION_NOTIFY && e->detail) {
+		struct output_event *last = &queue[(head + count - 1) % OUTPUT_QUEUE_SIZE];
+		if (last->type == XCB_MOTION_NOTIFY && last->detail) {
+			last->x += e->x;
+			last->y += e->y;
+			pthread_mutex_unlock(&lock);
+			return;
+		}
+	}
+
+	/* A warp supersedes any motion still waiting to go out. */
+	if (count > 0 && e->type == XCB_MOTION_NOTIFY && !e->detail) {
+		struct output_event *last = &queue[(head + count - 1) % OUTPUT_QUEUE_SIZE];
+		if (last->type == XCB_MOTION_NOTIFY) {
+			*last = *e;
+			pthread_mutex_unlock(&lock);
+			return;
+		}
+	}
+
+	while (count == OUTPUT_QUEUE_SIZE && !broken)
+		pthread_cond_wait(&nonfull, &lock);
+
+	if (!broken) {
+		if (count == 0)
+			queued_at = clock_nsec();
+		queue[(head + count) % OUTPUT_QUEUE_SIZE] = *e;
+		count++;
+		pthread_cond_signal(&nonempty);
+	}
+
+	pthread_mutex_unlock(&lock);
+}
+
+/* Move the pointer relative to its current position. */
+void output_motion(int xdelta, int ydelta)
+{
+	struct output_event e = { XCB_MOTION_NOTIFY, 1, xdelta, ydelta, 0 };
+	output_push(&e);
+}
+
+/* Move the pointer to a position on the root window. */
+void output_warp(int x, int y)
+{
+	struct output_event e = { XCB_MOTION_NOTIFY, 0, x, y, 0 };
+	output_push(&e);
+}
+
+/* Press or release a pointer button. */
+void output_button(unsigned button, int pressed)
+{
+	struct output_event e = {
+		pressed ? XCB_BUTTON_PRESS : XCB_BUTTON_RELEASE, button, 0, 0, 0
+	};
+	output_push(&e);
+}
+
+/* Press or release a key, by key code. */
+void output_key(unsigned keycode, int pressed)
+{
+	struct output_event e = {
+		pressed ? XCB_KEY_PRESS : XCB_KEY_RELEASE, keycode, 0, 0, 0
+	};
+	output_push(&e);
+}
+
+/*
+ * Give keycode the keysym, at every shift level.
+ * Events queued after this one see the new binding.
+ */
+void output_remap(unsigned keycode, unsigned keysym)
+{
+	struct output_event e = { OUTPUT_REMAP, keycode, 0, 0, keysym };
+	output_push(&e);
+}
+
+/* Hold back what is queued from now on, to send it as one batch. */
+void output_batch_begin()
+{
+	pthread_mutex_lock(&lock);
+	batching++;
+	pthread_mutex_unlock(&lock);
+}
+
+/* Send what was held back, if this ends the outermost batch. */
+void output_batch_end()
+{
+	pthread_mutex_lock(&lock);
+	if (batching > 0 && --batching == 0)
+		pthread_cond_signal(&nonempty);
+	pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Block until everything queued so far has been handled by the server,
+ *  for callers that are about to ask the server about its results.
+ */
+void output_drain()
+{
+	pthread_mutex_lock(&lock);
+	want_sync = 1;
+	pthread_cond_signal(&nonempty);
+	while ((want_sync || count > 0 || busy) && !broken)
+		pthread_cond_wait(&drained, &lock);
+	pthread_mutex_unlock(&lock);
+}
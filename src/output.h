@@ -0,0 +1,47 @@
+/*
+ * output.h
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __mousepad_output_h__
+#define __mousepad_output_h__
+
+/*
+ * Number of injected events that may wait for the X server.
+ * A batch of typed text needs up to six events per character.
+ */
+#define OUTPUT_QUEUE_SIZE 4096
+
+/* Number of flushed batches the server may leave unacknowledged. */
+#define OUTPUT_MAX_INFLIGHT 4
+
+/* Default for the longest a batch may hold back an event. */
+#define OUTPUT_MAX_LATENCY_MILLISECONDS 5
+
+int output_init(int verbose);
+void output_close();
+void output_motion(int xdelta, int ydelta);
+void output_warp(int x, int y);
+void output_button(unsigned button, int pressed);
+void output_key(unsigned keycode, int pressed);
+void output_remap(unsigned keycode, unsigned keysym);
+void output_batch_begin();
+void output_batch_end();
+void output_drain();
+
+#endif /* __mousepad_output_h__ */
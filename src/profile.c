@@ -0,0 +1,322 @@
+/*
+ * profile.c
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "profile.h"
+#include "config.h"
+#include "keyboard.h"
+#include "mouse.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+
+/*
+ * Per-application profiles: a "[name]" section of the settings file
+ *  applies while a window whose WM_CLASS class or instance is name has
+ *  the focus. A section may name its own layout file with "layout",
+ *  and override any of the mouse acceleration settings.
+ *
+ * The window manager announces each focus change by setting
+ *  _NET_ACTIVE_WINDOW on the root window, so nothing is asked of the
+ *  server until the focus actually moves.
+ * A section is read the first time one of its windows is focused, and
+ *  every class seen is remembered with the profile it resolved to.
+ *  Each window is remembered too, until it is destroyed, so focusing
+ *  it again costs reading the property and swapping pointers.
+ */
+struct profile
+{
+	char *section;             /* NULL for the default profile. */
+	const layout_t *layout;
+	int stock;                 /* The layout is the built-in one. */
+	const mouse_accel_t *accel;
+	struct profile *next;
+};
+
+static Display *display;
+static Window root;
+static Atom net_active_window;
+
+static struct profile profile_default;
+static struct profile *profiles = NULL; /* Sections read so far. */
+static const struct profile *current = NULL;
+
+/* Classes seen, replaced oldest first once the table is full. */
+static struct
+{
+	char *name, *class;
+	const struct profile *profile;
+} classes[PROFILE_MAX_CLASSES];
+static int nclasses = 0;
+static int oldest = 0;
+
+/* Windows seen, replaced oldest first once the table is full. */
+static struct
+{
+	Window id;
+	const struct profile *profile;
+} windows[PROFILE_MAX_WINDOWS];
+static int nwindows = 0;
+static int oldest_window = 0;
+
+static int profile_failed;
+
+/* Windows may vanish before their class is read; that is not fatal. */
+static int profile_error(Display *d, XErrorEvent *error)
+{
+	profile_failed = 1;
+	return 0;
+}
+
+/* Read a section's layout file and mouse settings, falling back on errors. */
+static struct profile *profile_read(const char *section)
+{
+	struct profile *p = malloc(sizeof(struct profile));
+	if (p == NULL)
+		return NULL;
+
+	*p = profile_default;
+	p->section = strdup(section);
+	config_section(section);
+
+	const char *path = config_string("layout", NULL);
+	if (path != NULL) {
+		layout_t *l = malloc(sizeof(layout_t));
+		FILE *f = fopen(path, "r");
+		if (l == NULL || f == NULL || layout_read(f, l) < 0) {
+			fprintf(stderr, " Could not read layout %s for [%s].\n",
+			        path, section);
+			free(l);
+		} else {
+			p->layout = l;
+			p->stock = 0;
+		}
+		if (f != NULL)
+			fclose(f);
+	}
+
+	mouse_accel_t *a = malloc(sizeof(mouse_accel_t));
+	if (a != NULL && mouse_read_accel(a) == 0) {
+		p->accel = a;
+	} else {
+		fprintf(stderr, " Using the default mouse settings for [%s].\n",
+		        section);
+		free(a);
+	}
+
+	config_section(NULL);
+
+	p->next = profiles;
+	profiles = p;
+	return p;
+}
+
+/* Returns the profile for a window class, reading its section if needed. */
+static const struct profile *profile_resolve(const char *name, const char *class)
+{
+	const char *section = NULL;
+
+	if (class && config_has_section(class))
+		section = class;
+	else if (name && config_has_section(name))
+		section = name;
+
+	if (section == NULL)
+		return &profile_default;
+
+	for (struct profile *p = profiles; p; p = p->next)
+		if (!strcmp(p->section, section))
+			return p;
+
+	struct profile *p = profile_read(section);
+	return p ? p : &profile_default;
+}
+
+/* Remember the profile for window w, until it is destroyed. */
+static void profile_remember(Window w, const struct profile *p)
+{
+	int i = nwindows;
+
+	if (nwindows == PROFILE_MAX_WINDOWS) {
+		i = oldest_window;
+		oldest_window = (oldest_window + 1) % PROFILE_MAX_WINDOWS;
+	} else {
+		nwindows++;
+	}
+	windows[i].id = w;
+	windows[i].profile = p;
+}
+
+static void profile_forget(Window w)
+{
+	for (int i = 0; i < nwindows; i++) {
+		if (windows[i].id == w) {
+			windows[i] = windows[--nwindows];
+			if (oldest_window >= nwindows)
+				oldest_window = 0;
+			return;
+		}
+	}
+}
+
+/*
+ * Returns the profile for a window: the one it had before, or else the
+ *  one for its class, looking in the class cache first.
+ */
+static const struct profile *profile_lookup(Window w)
+{
+	const struct profile *p;
+	XClassHint hint = { NULL, NULL };
+
+	if (w == None)
+		return &profile_default;
+
+	for (int i = 0; i < nwindows; i++)
+		if (windows[i].id == w)
+			return windows[i].profile;
+
+	/*
+	 * Ask to hear of the window's destruction, to forget it then.
+	 * Any error from that arrives during the round trip that follows.
+	 */
+	profile_failed = 0;
+	XErrorHandler handler = XSetErrorHandler(profile_error);
+	XSelectInput(display, w, StructureNotifyMask);
+	Status ok = XGetClassHint(display, w, &hint);
+	XSetErrorHandler(handler);
+
+	/* A window that is already gone is not worth remembering. */
+	if (profile_failed)
+		return &profile_default;
+	if (!ok) {
+		p = &profile_default;
+		goto done;
+	}
+
+	const char *name  = hint.res_name  ? hint.res_name  : "";
+	const char *class = hint.res_class ? hint.res_class : "";
+
+	for (int i = 0; i < nclasses; i++) {
+		if (!strcmp(classes[i].name, name) && !strcmp(classes[i].class, class)) {
+			p = classes[i].profile;
+			goto done;
+		}
+	}
+
+	p = profile_resolve(name, class);
+
+	int i = nclasses;
+	if (nclasses == PROFILE_MAX_CLASSES) {
+		i = oldest;
+		oldest = (oldest + 1) % PROFILE_MAX_CLASSES;
+		free(classes[i].name);
+		free(classes[i].class);
+	} else {
+		nclasses++;
+	}
+	classes[i].name = strdup(name);
+	classes[i].class = strdup(class);
+	classes[i].profile = p;
+
+done:
+	profile_remember(w, p);
+	if (hint.res_name)
+		XFree(hint.res_name);
+	if (hint.res_class)
+		XFree(hint.res_class);
+	return p;
+}
+
+static void profile_use(const struct profile *p)
+{
+	if (p == current)
+		return;
+
+	current = p;
+	keyboard_set_layout(p->layout, p->stock);
+	mouse_use_accel(p->accel);
+}
+
+/* Switch to the profile for whichever window is now active. */
+static void profile_focus()
+{
+	Atom type;
+	int format;
+	unsigned long n, after;
+	unsigned char *data = NULL;
+	Window w = None;
+
+	if (XGetWindowProperty(display, root, net_active_window, 0, 1, False,
+	                       XA_WINDOW, &type, &format, &n, &after,
+	                       &data) == Success && data != NULL) {
+		if (type == XA_WINDOW && format == 32 && n == 1)
+			w = *(Window *)data;
+		XFree(data);
+	}
+
+	profile_use(profile_lookup(w));
+}
+
+/*
+ * Start following the active window on d's default screen.
+ * layout is the one to use where no profile names its own, and stock
+ *  is nonzero if it is the built-in one.
+ */
+int profile_init(Display *d, const layout_t *layout, int stock)
+{
+	XWindowAttributes attr;
+
+	if (d == NULL) return -1;
+
+	display = d;
+	root = RootWindow(d, DefaultScreen(d));
+	net_active_window = XInternAtom(d, "_NET_ACTIVE_WINDOW", False);
+
+	profile_default.layout = layout;
+	profile_default.stock = stock;
+	profile_default.accel = NULL;
+	current = &profile_default;
+
+	/* Other modules listen on the root window through the same connection. */
+	if (!XGetWindowAttributes(d, root, &attr))
+		return -1;
+	XSelectInput(d, root, attr.your_event_mask | PropertyChangeMask);
+
+	profile_focus();
+	return 0;
+}
+
+/* Handle a change of active window, or the destruction of a window. */
+void profile_event(const XEvent *xev)
+{
+	if (xev->type == DestroyNotify) {
+		profile_forget(xev->xdestroywindow.window);
+		return;
+	}
+
+	if (xev->type != PropertyNotify || xev->xproperty.window != root ||
+	    xev->xproperty.atom != net_active_window)
+		return;
+
+	profile_focus();
+}
@@ -0,0 +1,38 @@
+/*
+ * profile.h
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __mousepad_profile_h__
+#define __mousepad_profile_h__
+
+#include "layout.h"
+
+#include <X11/X.h>
+#include <X11/Xlib.h>
+
+/* Window classes remembered, with the profile each one resolved to. */
+#define PROFILE_MAX_CLASSES 64
+
+/* Windows remembered likewise, until they are destroyed. */
+#define PROFILE_MAX_WINDOWS 256
+
+int profile_init(Display *d, const layout_t *layout, int stock);
+void profile_event(const XEvent *xev);
+
+#endif /* __mousepad_profile_h__ */
@@ -0,0 +1,149 @@
+/*
+ * repeat.c
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repeat.h"
+#include "clock.h"
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <X11/Xlib.h>
+
+#define REPEAT_MAX_KEYS 32
+
+/*
+ * Auto-repeat: after an action, it runs again and again for as long as
+ *  the buttons that caused it stay held, first after the delay and then
+ *  at a rate that climbs the longer they are held.
+ *
+ * Each repeat is due at an absolute time, computed from the previous
+ *  deadline rather than from when the timer actually fired, so late
+ *  wakeups don't slow the rate down.
+ */
+
+static long long delay;
+static double rate, acceleration, max_rate;
+static int clicks;
+static KeySym keys[REPEAT_MAX_KEYS];
+static int nkeys = 0;
+
+static buttonstate_t held; /* Buttons that keep it going, or 0 if idle. */
+static void (*action)(int arg);
+static int action_arg;
+static long long started, next;
+
+/* Read settings. */
+void repeat_init()
+{
+	char list[256];
+
+	delay = config_int("repeat_delay", REPEAT_DELAY_MILLISECONDS) * NSEC_PER_MSEC;
+	rate = config_float("repeat_rate", REPEAT_RATE);
+	acceleration = config_float("repeat_acceleration", REPEAT_ACCELERATION);
+	max_rate = config_float("repeat_max_rate", REPEAT_MAX_RATE);
+	clicks = config_int("repeat_clicks", 0);
+
+	strncpy(list, config_string("repeat_keys", REPEAT_KEYS), sizeof(list) - 1);
+	list[sizeof(list) - 1] = '\0';
+	nkeys = 0;
+	for (char *w = strtok(list, " \t"); w && nkeys < REPEAT_MAX_KEYS;
+	     w = strtok(NULL, " \t")) {
+		KeySym sym = XStringToKeysym(w);
+		if (sym != NoSymbol)
+			keys[nkeys++] = sym;
+	}
+
+	if (rate <= 0)
+		rate = REPEAT_RATE;
+	/* The rate only climbs, so it never reaches zero between repeats. */
+	if (acceleration < 0)
+		acceleration = 0;
+	if (max_rate < rate)
+		max_rate = rate;
+}
+
+/* Returns nonzero if the keysym should repeat while held. */
+int repeat_key(unsigned long keysym)
+{
+	for (int i = 0; i < nkeys; i++)
+		if (keys[i] == keysym)
+			return 1;
+	return 0;
+}
+
+/* Returns nonzero if clicks should repeat while held. */
+int repeat_clicks()
+{
+	return clicks;
+}
+
+/*
+ * Repeat action(arg), which just ran, while every button in h stays held.
+ * Replaces any repeat already going.
+ */
+void repeat_start(buttonstate_t h, void (*a)(int arg), int arg)
+{
+	if (!h) return;
+
+	held = h;
+	action = a;
+	action_arg = arg;
+	started = clock_nsec();
+	next = started + delay;
+}
+
+void repeat_stop()
+{
+	held = 0;
+}
+
+/* Stop repeating once a button that kept it going is released. */
+void repeat_event(buttonstate_t buttons)
+{
+	if (held && (buttons & held) != held)
+		held = 0;
+}
+
+/* Returns nonzero and sets when to the time of the next repeat, if any. */
+int repeat_deadline(long long *when)
+{
+	if (!held)
+		return 0;
+	*when = next;
+	return 1;
+}
+
+/* Run every repeat that has come due. */
+void repeat_tick(long long now)
+{
+	while (held && next <= now) {
+		double r = rate + acceleration * (next - started - delay) / NSEC_PER_SEC;
+		if (r > max_rate)
+			r = max_rate;
+
+		action(action_arg);
+		next += NSEC_PER_SEC / r;
+
+		/* After a long stall, carry on from now instead of catching up. */
+		if (next < now - delay)
+			next = now;
+	}
+}
@@ -0,0 +1,42 @@
+/*
+ * repeat.h
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __mousepad_repeat_h__
+#define __mousepad_repeat_h__
+
+#include "mousepad.h"
+
+/* Defaults; each is overridable in the settings file. */
+#define REPEAT_DELAY_MILLISECONDS 400
+#define REPEAT_RATE 20.0         /* repeats per second, at first */
+#define REPEAT_ACCELERATION 10.0 /* repeats per second, gained each second */
+#define REPEAT_MAX_RATE 60.0
+#define REPEAT_KEYS "BackSpace Delete Left Up Right Down"
+
+void repeat_init();
+int repeat_key(unsigned long keysym);
+int repeat_clicks();
+void repeat_start(buttonstate_t held, void (*action)(int arg), int arg);
+void repeat_stop();
+void repeat_event(buttonstate_t buttons);
+int repeat_deadline(long long *when);
+void repeat_tick(long long now);
+
+#endif /* __mousepad_repeat_h__ */
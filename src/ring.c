@@ -0,0 +1,120 @@
+/*
+ * ring.c
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ring.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+/* Ring initialization. Returns -1 if the eventfds can't be created. */
+int ring_init(ring_t *r)
+{
+	memset(r, 0x0, sizeof(ring_t));
+
+	r->readyfd = eventfd(0, EFD_NONBLOCK);
+	r->spacefd = eventfd(0, 0);
+	if (r->readyfd < 0 || r->spacefd < 0) {
+		ring_close(r);
+		return -1;
+	}
+
+	return 0;
+}
+
+void ring_close(ring_t *r)
+{
+	if (r->readyfd >= 0)
+		close(r->readyfd);
+	if (r->spacefd >= 0)
+		close(r->spacefd);
+	r->readyfd = r->spacefd = -1;
+}
+
+/* The consumer polls this descriptor to learn about new events. */
+int ring_fd(ring_t *r)
+{
+	return r->readyfd;
+}
+
+/*
+ * Producer: stage an event for the next ring_signal().
+ * Events are never dropped: if the consumer has fallen a whole ring behind,
+ *  the producer sleeps until a slot frees up. The kernel keeps buffering
+ *  pad input in the meantime.
+ */
+void ring_push(ring_t *r, const struct padevent *e)
+{
+	unsigned head = r->staged;
+
+	while (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == RING_SIZE) {
+		ring_signal(r);
+
+		__atomic_store_n(&r->waiting, 1, __ATOMIC_SEQ_CST);
+		if (head - __atomic_load_n(&r->tail, __ATOMIC_SEQ_CST) == RING_SIZE) {
+			uint64_t n;
+			read(r->spacefd, &n, sizeof(uint64_t));
+		}
+		__atomic_store_n(&r->waiting, 0, __ATOMIC_SEQ_CST);
+	}
+
+	r->events[head & (RING_SIZE - 1)] = *e;
+	r->staged = head + 1;
+}
+
+/* Producer: publish everything pushed so far, and wake the consumer. */
+void ring_signal(ring_t *r)
+{
+	uint64_t n = 1;
+
+	if (r->staged == r->head)
+		return;
+
+	__atomic_store_n(&r->head, r->staged, __ATOMIC_RELEASE);
+	write(r->readyfd, &n, sizeof(uint64_t));
+}
+
+/* Consumer: acknowledge a wakeup before draining with ring_pop(). */
+void ring_clear(ring_t *r)
+{
+	uint64_t n;
+	read(r->readyfd, &n, sizeof(uint64_t));
+}
+
+/* Consumer: take the oldest event. Returns 0 if the ring is empty. */
+int ring_pop(ring_t *r, struct padevent *e)
+{
+	unsigned tail = r->tail;
+
+	if (tail == __atomic_load_n(&r->head, __ATOMIC_ACQUIRE))
+		return 0;
+
+	*e = r->events[tail & (RING_SIZE - 1)];
+	__atomic_store_n(&r->tail, tail + 1, __ATOMIC_SEQ_CST);
+
+	/* Release a producer sleeping on a full ring. */
+	if (__atomic_load_n(&r->waiting, __ATOMIC_SEQ_CST)) {
+		uint64_t n = 1;
+		write(r->spacefd, &n, sizeof(uint64_t));
+	}
+
+	return 1;
+}
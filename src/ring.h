@@ -0,0 +1,76 @@
+/*
+ * ring.h
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __mousepad_ring_h__
+#define __mousepad_ring_h__
+
+#include "mousepad.h"
+
+/* Number of slots in the ring. Must be a power of two. */
+#define RING_SIZE 256
+
+#define PADEVENT_BUTTON     0
+#define PADEVENT_DISCONNECT 1
+#define PADEVENT_AXIS       2
+
+/* Range of PADEVENT_AXIS values, whatever the device reports. */
+#define PADEVENT_AXIS_MAX 32767
+
+/* A single timestamped pad event, as handed from the input thread. */
+struct padevent
+{
+	long long time;  /* CLOCK_MONOTONIC nanoseconds at which it was read. */
+	int type;        /* One of the PADEVENT defines. */
+	button_t button; /* For PADEVENT_BUTTON, the button that changed. */
+	int axis;        /* For PADEVENT_AXIS, the axis number. */
+	int value;       /* For PADEVENT_BUTTON, nonzero if pressed; for
+	                    PADEVENT_AXIS, the position, within
+	                    +/- PADEVENT_AXIS_MAX. */
+};
+
+/*
+ * Lock-free single-producer, single-consumer queue of pad events.
+ * The producer only writes head, the consumer only writes tail;
+ *  they live on separate cache lines so the threads never share one.
+ * Pushed events stay invisible to the consumer until ring_signal(),
+ *  so that a frame of simultaneous events is always handed over whole.
+ */
+typedef struct
+{
+	struct padevent events[RING_SIZE];
+
+	unsigned head __attribute__((aligned(64)));
+	unsigned staged; /* Producer-private head, published by ring_signal(). */
+	unsigned tail __attribute__((aligned(64)));
+
+	int waiting; /* Nonzero while the producer sleeps on a full ring. */
+	int readyfd; /* eventfd, readable when events have been pushed. */
+	int spacefd; /* eventfd, written when a waiting producer may continue. */
+} ring_t;
+
+int ring_init(ring_t *r);
+void ring_close(ring_t *r);
+int ring_fd(ring_t *r);
+void ring_push(ring_t *r, const struct padevent *e);
+void ring_signal(ring_t *r);
+void ring_clear(ring_t *r);
+int ring_pop(ring_t *r, struct padevent *e);
+
+#endif /* __mousepad_ring_h__ */
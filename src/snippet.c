@@ -0,0 +1,230 @@
+/*
+ * snippet.c
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "snippet.h"
+#include "keyboard.h"
+#include "output.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <X11/keysym.h>
+
+#define SNIPPET_LINE_LENGTH (SNIPPET_MAX_TRIGGER + 2 * SNIPPET_MAX_TEXT)
+
+/*
+ * Text expansion: the last few characters typed are kept, and as soon
+ *  as they end with a snippet's trigger, the trigger is erased and the
+ *  snippet's text typed in its place. A trigger that begins with a
+ *  letter or digit only counts at the start of a word, so "sig" won't
+ *  fire in the middle of "design".
+ *
+ * The erasing and the text go out as one batch of injected events,
+ *  with one flush, however long the text is.
+ *
+ * Snippets are indexed by the last character of their trigger, so a key
+ *  only looks at the few triggers it could complete.
+ */
+struct snippet
+{
+	char trigger[SNIPPET_MAX_TRIGGER + 1];
+	int len;
+	char *text;
+	int next; /* Next snippet whose trigger ends the same way, or -1. */
+};
+
+static struct snippet *snippets;
+static int nsnippets = 0;
+static int by_last[256];
+
+/* The latest characters typed, oldest first, with one to spare. */
+static char typed[SNIPPET_MAX_TRIGGER + 1];
+static int ntyped = 0;
+static int expanding = 0;
+
+/* Copies text into buf, turning \n, \t and \\ into what they stand for. */
+static void snippet_unescape(const char *text, char *buf)
+{
+	for (; *text; text++) {
+		if (text[0] != '\\' || text[1] == '\0') {
+			*buf++ = *text;
+			continue;
+		}
+		switch (*++text) {
+			case 'n': *buf++ = '\n'; break;
+			case 't': *buf++ = '\t'; break;
+			default:  *buf++ = *text; break;
+		}
+	}
+	*buf = '\0';
+}
+
+/*
+ * Parse one "trigger text" line; a later trigger replaces an earlier one.
+ * Returns -1 on a malformed line.
+ */
+static int snippet_parse(char *line)
+{
+	char buf[SNIPPET_MAX_TEXT + 1];
+
+	line[strcspn(line, "\r\n")] = '\0';
+	line += strspn(line, " \t");
+	if (line[0] == '\0' || line[0] == '#')
+		return 0;
+
+	char *text = line + strcspn(line, " \t");
+	if (*text)
+		*text++ = '\0';
+	text += strspn(text, " \t");
+
+	int len = strlen(line);
+	if (len > SNIPPET_MAX_TRIGGER || text[0] == '\0' ||
+	    strlen(text) > SNIPPET_MAX_TEXT)
+		return -1;
+	snippet_unescape(text, buf);
+
+	unsigned char last = line[len - 1];
+	for (int i = by_last[last]; i >= 0; i = snippets[i].next) {
+		if (!strcmp(snippets[i].trigger, line)) {
+			free(snippets[i].text);
+			snippets[i].text = strdup(buf);
+			return 0;
+		}
+	}
+
+	struct snippet *s = realloc(snippets, (nsnippets + 1) * sizeof(*snippets));
+	if (s == NULL)
+		return -1;
+	snippets = s;
+
+	s = &snippets[nsnippets];
+	strcpy(s->trigger, line);
+	s->len = len;
+	s->text = strdup(buf);
+	s->next = by_last[last];
+	by_last[last] = nsnippets++;
+	return 0;
+}
+
+static int snippet_read(const char *path)
+{
+	char line[SNIPPET_LINE_LENGTH];
+	int n = 0;
+
+	FILE *f = fopen(path, "r");
+	if (f == NULL)
+		return 0;
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		n++;
+		if (snippet_parse(line) < 0) {
+			fprintf(stderr, " %s:%d: bad snippet.\n", path, n);
+			fclose(f);
+			return -1;
+		}
+	}
+
+	fclose(f);
+	return 0;
+}
+
+/* Read /etc/SNIPPET_FILENAME, then ~/.SNIPPET_FILENAME. */
+int snippet_init()
+{
+	char path[512];
+	char *home = getenv("HOME");
+
+	memset(by_last, 0xff, sizeof(by_last));
+
+	if (snippet_read("/etc/"SNIPPET_FILENAME) < 0)
+		return -1;
+
+	if (home != NULL) {
+		snprintf(path, sizeof(path), "%s/."SNIPPET_FILENAME, home);
+		if (snippet_read(path) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Erase the trigger just typed, and type the snippet's text instead,
+ *  as written: a locked Shift or Ctrl is not held around it.
+ */
+static void snippet_expand(const struct snippet *s)
+{
+	expanding = 1;
+	keyboard_suspend_modifiers();
+	output_batch_begin();
+	for (int i = 0; i < s->len; i++)
+		keyboard_press(XK_BackSpace);
+	keyboard_type(s->text);
+	output_batch_end();
+	keyboard_resume_modifiers();
+	expanding = 0;
+
+	ntyped = 0;
+}
+
+/*
+ * Follow a key that was typed. modified is nonzero if Ctrl, Alt or Super
+ *  was held, which makes it a command rather than text.
+ */
+void snippet_key(KeySym key, int modified)
+{
+	const struct snippet *match = NULL;
+
+	if (expanding || nsnippets == 0)
+		return;
+
+	if (modified || key < XK_space || key > XK_asciitilde) {
+		if (key == XK_BackSpace && !modified && ntyped > 0)
+			ntyped--;
+		else
+			ntyped = 0;
+		return;
+	}
+
+	if (ntyped == sizeof(typed)) {
+		memmove(typed, typed + 1, sizeof(typed) - 1);
+		ntyped--;
+	}
+	typed[ntyped++] = key;
+
+	/* The longest trigger that was typed at the start of a word wins. */
+	for (int i = by_last[key]; i >= 0; i = snippets[i].next) {
+		const struct snippet *s = &snippets[i];
+		int start = ntyped - s->len;
+
+		if (start < 0 || memcmp(typed + start, s->trigger, s->len))
+			continue;
+		if (start > 0 && isalnum((unsigned char)s->trigger[0]) &&
+		    isalnum((unsigned char)typed[start - 1]))
+			continue;
+		if (match == NULL || s->len > match->len)
+			match = s;
+	}
+
+	if (match)
+		snippet_expand(match);
+}
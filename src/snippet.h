@@ -0,0 +1,35 @@
+/*
+ * snippet.h
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __mousepad_snippet_h__
+#define __mousepad_snippet_h__
+
+#include <X11/X.h>
+
+#define SNIPPET_FILENAME "mousepad.snippets"
+
+/* Longest trigger, and longest expansion, in bytes. */
+#define SNIPPET_MAX_TRIGGER 16
+#define SNIPPET_MAX_TEXT    512
+
+int snippet_init();
+void snippet_key(KeySym key, int modified);
+
+#endif /* __mousepad_snippet_h__ */
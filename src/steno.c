@@ -0,0 +1,225 @@
+/*
+ * steno.c
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "steno.h"
+#include "gesture.h"
+#include "keyboard.h"
+#include "layout.h"
+#include "mode.h"
+#include "output.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <X11/keysym.h>
+
+#define STENO_LINE_LENGTH (STENO_MAX_TEXT + 128)
+
+/*
+ * Steno mode: every button on the pad is a panel, and a stroke is
+ *  the set of panels pressed before all of them are released again.
+ *  Each stroke types a whole word or phrase from the dictionary,
+ *  followed by a space. Text starting with '^' is attached to the word
+ *  before it instead, for suffixes and punctuation.
+ * Start on its own leaves steno mode; Back on its own takes back the
+ *  last stroke.
+ *
+ * The dictionary is indexed directly by the stroke's button bits.
+ */
+static char *strokes[1 << NBUTTONS];
+
+static buttonstate_t stroke; /* Panels pressed since the last stroke. */
+static int last_len;         /* Characters typed by the last stroke. */
+static int last_attached;    /* It took back the space before it. */
+
+/* The shared default dictionary, in the same format as the files. */
+static const char *steno_builtin[] = {
+	"left+up the",          "left+right and",       "left+down to",
+	"left+upleft of",       "left+upright a",       "left+downleft in",
+	"left+downright is",    "up+right it",          "up+down that",
+	"up+upleft you",        "up+upright for",       "up+downleft on",
+	"up+downright with",    "right+down was",       "right+upleft as",
+	"right+upright have",   "right+downleft be",    "right+downright at",
+	"down+upleft this",     "down+upright not",     "down+downleft but",
+	"down+downright from",  "upleft+upright I",     "upleft+downleft or",
+	"upleft+downright by",  "upright+downleft we",  "upright+downright they",
+	"downleft+downright will",
+
+	"start+up ^s",          "start+right ^ed",      "start+down ^ly",
+	"start+left ^ing",      "start+upleft ^.",      "start+upright ^,",
+	"start+downleft ^?",    "start+downright ^!",
+	NULL
+};
+
+/* Parses a stroke such as "left+right+start". Returns 0 if malformed. */
+static buttonstate_t steno_stroke(char *text)
+{
+	buttonstate_t s = 0;
+
+	for (char *name = strtok(text, "+"); name; name = strtok(NULL, "+")) {
+		button_t b = layout_button(name);
+		if (b == 0)
+			return 0;
+		s |= b;
+	}
+	return s;
+}
+
+/*
+ * Parse one "stroke text" line. A stroke with no text removes it from
+ *  the dictionary. Returns -1 on a malformed line.
+ */
+static int steno_parse(char *line)
+{
+	line[strcspn(line, "\r\n")] = '\0';
+	line += strspn(line, " \t");
+	if (line[0] == '\0' || line[0] == '#')
+		return 0;
+
+	char *text = line + strcspn(line, " \t");
+	if (*text)
+		*text++ = '\0';
+	text += strspn(text, " \t");
+	for (char *end = text + strlen(text); end > text && (end[-1] == ' ' ||
+	     end[-1] == '\t'); end--)
+		end[-1] = '\0';
+
+	buttonstate_t s = steno_stroke(line);
+	if (s == 0 || s == BUTTON_START || s == BUTTON_BACK ||
+	    strlen(text) > STENO_MAX_TEXT)
+		return -1;
+
+	free(strokes[s]);
+	strokes[s] = text[0] ? strdup(text) : NULL;
+	return 0;
+}
+
+static int steno_read(const char *path)
+{
+	char line[STENO_LINE_LENGTH];
+	int n = 0;
+
+	FILE *f = fopen(path, "r");
+	if (f == NULL)
+		return 0;
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		n++;
+		if (steno_parse(line) < 0) {
+			fprintf(stderr, " %s:%d: bad stroke.\n", path, n);
+			fclose(f);
+			return -1;
+		}
+	}
+
+	fclose(f);
+	return 0;
+}
+
+/*
+ * Build the dictionary: the built-in one, then /etc/STENO_FILENAME,
+ *  then ~/.STENO_FILENAME, each overriding the strokes it names.
+ */
+int steno_init()
+{
+	char line[STENO_LINE_LENGTH];
+	char path[512];
+	char *home = getenv("HOME");
+
+	for (int i = 0; steno_builtin[i] != NULL; i++) {
+		strcpy(line, steno_builtin[i]);
+		steno_parse(line);
+	}
+
+	if (steno_read("/etc/"STENO_FILENAME) < 0)
+		return -1;
+
+	if (home != NULL) {
+		snprintf(path, sizeof(path), "%s/."STENO_FILENAME, home);
+		if (steno_read(path) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/* Begin steno mode. */
+void steno_begin()
+{
+	stroke = 0;
+	last_len = 0;
+	gesture_use(NULL, 0, steno_event);
+}
+
+/* End steno mode. */
+void steno_end()
+{
+}
+
+/* Type a stroke's text, with its space, as one batch. */
+static void steno_type(const char *text)
+{
+	int attach = (text[0] == '^') && last_len;
+
+	output_batch_begin();
+	if (attach)
+		keyboard_press(XK_BackSpace);
+	last_len = keyboard_type(text[0] == '^' ? text + 1 : text);
+	keyboard_press(XK_space);
+	last_len++;
+	last_attached = attach;
+	output_batch_end();
+}
+
+/* Take back the last stroke, putting back the space it attached to. */
+static void steno_undo()
+{
+	output_batch_begin();
+	for (; last_len > 0; last_len--)
+		keyboard_press(XK_BackSpace);
+	if (last_attached)
+		keyboard_press(XK_space);
+	last_attached = 0;
+	output_batch_end();
+}
+
+/* A stroke is finished when every panel in it has been released. */
+void steno_event(buttonstate_t buttons, button_t changed)
+{
+	if (!changed) return;
+
+	if (buttons & changed) {
+		stroke |= changed;
+		return;
+	}
+	if (buttons)
+		return;
+
+	buttonstate_t s = stroke;
+	stroke = 0;
+
+	if (s == BUTTON_START)
+		mode_toggle(0);
+	else if (s == BUTTON_BACK)
+		steno_undo();
+	else if (strokes[s] != NULL)
+		steno_type(strokes[s]);
+}
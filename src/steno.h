@@ -0,0 +1,36 @@
+/*
+ * steno.h
+ * Copyright Sean Stangl <sean.stangl@gmail.com> 2005-2011
+ *
+ * This file is part of Mousepad.
+ *
+ * Mousepad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mousepad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with mousepad.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __mousepad_steno_h__
+#define __mousepad_steno_h__
+
+#include "mousepad.h"
+
+#define STENO_FILENAME "mousepad.steno"
+
+/* Longest text a stroke may type, in bytes. */
+#define STENO_MAX_TEXT 128
+
+int steno_init();
+void steno_begin();
+void steno_end();
+void steno_event(buttonstate_t buttons, button_t changed);
+
+#endif /* __mousepad_steno_h__ */